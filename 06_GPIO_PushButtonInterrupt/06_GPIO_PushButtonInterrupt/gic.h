@@ -71,3 +71,9 @@
 #define GICC_IAR_SPURIOUS_INTR	(0x3ff)			// 1023 means spurious interrupt
 #define GICC_IAR_CPU_IDMASK		(0x1c00)		// Bits 10-12: CPU ID
 
+
+// The GIC interrupt ID of GPIO bank 0 (pins 0 - 27) on the BCM2711. The
+// VideoCore peripheral interrupts start at ID 96, and this is VideoCore
+// interrupt 49. It is bit 17 of GICD_ISENABLER4 (and the other 1-bit
+// registers), since each register covers 32 IDs.
+#define GPIO_BANK0_IRQ_ID		145
@@ -77,12 +77,12 @@ void IRQ_handler()
 
     // Print out active interrupts after acknowledge
     uart_puts("  Active interrupts after acknowledge:\n");
-	r = *(GIC_GICD_ISACTIVER + (0 * 4));
+	r = *(GIC_GICD_ISACTIVER + 0);
 	uart_puts("    GICD_ISACTIVER0:  0x");
 	uart_puthex(r);
 	uart_puts("\n");
-	r = *(GIC_GICD_ISACTIVER + (1 * 4));
-	uart_puts("    GICD_ISACTIVER1:  0x");
+	r = *(GIC_GICD_ISACTIVER + (GPIO_BANK0_IRQ_ID / 32));
+	uart_puts("    GICD_ISACTIVER4:  0x");
 	uart_puthex(r);
 	uart_puts("\n");
 
@@ -95,7 +95,7 @@ void IRQ_handler()
 
     
     // Handle GPIO Bank 0 interrupts in general
-    if (*(GIC_GICD_ISACTIVER + (1 * 4)) & 0x00020000) {
+    if (interruptID == GPIO_BANK0_IRQ_ID) {
     	// Handle the interrupt associated with GPIO pin 1
 		if (*GPEDS0 == (0x1 << 1)) {
 			// Clear the interrupt by writing a 1 to the GPIO Event Detect
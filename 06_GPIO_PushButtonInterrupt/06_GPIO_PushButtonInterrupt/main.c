@@ -41,7 +41,7 @@ unsigned int sharedValue;
 
 void main()
 {
-    unsigned int localValue, value, el, i;
+    unsigned int localValue, value, el;
 
     
     // Set up the UART serial port
@@ -129,40 +129,35 @@ void main()
     
     // Set up the Generic Interrupt Controller
 
-    // First set all interrupts to the highest priority (0x00). Each register
-    // holds the priorities for 4 interrupts each, so we are setting 64
-    // interrupts in total (numbered 0 - 63).
-    for (i = 0; i < 16; i++) {
-		*(GIC_GICD_IPRIORITYR + (i * 4)) = 0x00000000;
-    }
+    // Set the Bank 0 GPIO interrupt to the highest priority (0x00). Each
+    // register holds the priorities of 4 interrupts, one byte each, so we
+    // write the interrupt's byte directly.
+    *((volatile unsigned char *)GIC_GICD_IPRIORITYR + GPIO_BANK0_IRQ_ID) = 0x00;
 
-    // Set supported SPIs targets to CPU 0 only (0x01, or 0b00000001). Each
-    // register holds the targets for 4 interrupts each, so we are setting 32
-    // interrupts in total (numbered 32 - 63).
-    for (i = 8; i < 16; i++) {
-		*(GIC_GICD_ITARGETSR + (i * 4)) = 0x01010101;
-    }
+    // Send the interrupt to CPU 0 only (0x01, or 0b00000001). Each register
+    // holds the targets of 4 interrupts, one byte each.
+    *((volatile unsigned char *)GIC_GICD_ITARGETSR + GPIO_BANK0_IRQ_ID) = 0x01;
 
-    // Set PPIs and supported SPIs to be edge-triggered and using the 1-N model
-    // (0b11). Each register holds the configuration for 16 interrupts each, so
-    // we are are setting 48 interrupts in total (numbered 16 - 63). Interrupts
-    // 0 - 15 (SGIs) are read-only (default to edge-triggered, N-N model).
-    for (i = 1; i < 4; i++) {
-		*(GIC_GICD_ICFGR + (i * 4)) = 0xFFFFFFFF;
-    }
+    // Make the interrupt edge-triggered, using the 1-N model (0b11). Each
+    // register holds the configuration of 16 interrupts, 2 bits each. Note
+    // that adding n to a register pointer moves n registers (4n bytes) on.
+    value = *(GIC_GICD_ICFGR + (GPIO_BANK0_IRQ_ID / 16));
+    value |= (0x3 << ((GPIO_BANK0_IRQ_ID % 16) * 2));
+    *(GIC_GICD_ICFGR + (GPIO_BANK0_IRQ_ID / 16)) = value;
 
-    // Enable Bank 0 GPIO interrupts in the GIC. Bit 17 in GICD_ISENABLER1 is
-    // for Bank 0 (pins 0 - 27).
+    // Enable Bank 0 GPIO interrupts in the GIC. This is bit 17 in
+    // GICD_ISENABLER4 (see gic.h).
     uart_puts("Enabling Bank 0 GPIO interrupts (pins 0 - 27) in GIC:\n");
-    *(GIC_GICD_ISENABLER + (1 * 4)) = 0x00020000;
+    *(GIC_GICD_ISENABLER + (GPIO_BANK0_IRQ_ID / 32)) =
+        (0x1 << (GPIO_BANK0_IRQ_ID % 32));
 
     // Print out enabled interrupts
-	value = *(GIC_GICD_ISENABLER + (0 * 4));
+	value = *(GIC_GICD_ISENABLER + 0);
 	uart_puts("  GICD_ISENABLER0:    0x");
 	uart_puthex(value);
 	uart_puts("\n");
-	value = *(GIC_GICD_ISENABLER + (1 * 4));
-	uart_puts("  GICD_ISENABLER1:    0x");
+	value = *(GIC_GICD_ISENABLER + (GPIO_BANK0_IRQ_ID / 32));
+	uart_puts("  GICD_ISENABLER4:    0x");
 	uart_puthex(value);
 	uart_puts("\n\n");
 
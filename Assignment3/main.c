@@ -17,8 +17,9 @@
 #define SLOW_MODE 0   // Slow LED sequence
 #define FAST_MODE 1   // Fast LED sequence
 
-/* GPIO Interrupt ID */
-#define GPIO_IRQ_ID 96
+/* GPIO Interrupt ID (GPIO bank 0 is VideoCore interrupt 49, which is GIC ID
+   96 + 49 on the BCM2711; ID 96 itself is System Timer channel 0) */
+#define GPIO_IRQ_ID 145
 
 /* Shared State Variable (Used in ISR and Main) */
 volatile unsigned int currentState;
@@ -94,32 +95,43 @@ void main()
 /* Interrupt Service Routine */
 void IRQ_handler()
 {
-    unsigned int ack = *GIC_GICC_IAR; // Acknowledge interrupt
-    unsigned int irqID = ack & 0x3FF; // Extract the interrupt ID
-
-    // Check if the interrupt was triggered by GPIO
-    if (irqID == GPIO_IRQ_ID)
+    // Keep acknowledging interrupts until the GIC reports a spurious ID
+    // (1020 - 1023), so that interrupts arriving together are handled in one
+    // exception
+    while (1)
     {
-        // Read the state of both buttons
-        unsigned int buttonA_state = read_GPIO0_state();
-        unsigned int buttonB_state = read_GPIO1_state();
+        unsigned int ack = *GIC_GICC_IAR; // Acknowledge interrupt
+        unsigned int irqID = ack & 0x3FF; // Extract the interrupt ID
 
-        // Update shared state based on button inputs
-        if (buttonA_state == 1)
+        if (irqID >= 1020)
         {
-            currentState = SLOW_MODE;
+            break;
         }
-        else if (buttonB_state == 0)
+
+        // Check if the interrupt was triggered by GPIO
+        if (irqID == GPIO_IRQ_ID)
         {
-            currentState = FAST_MODE;
+            // Read the state of both buttons
+            unsigned int buttonA_state = read_GPIO0_state();
+            unsigned int buttonB_state = read_GPIO1_state();
+
+            // Update shared state based on button inputs
+            if (buttonA_state == 1)
+            {
+                currentState = SLOW_MODE;
+            }
+            else if (buttonB_state == 0)
+            {
+                currentState = FAST_MODE;
+            }
+
+            // Clear interrupt flags for both buttons
+            *GPEDS0 = (1 << BTN_A) | (1 << BTN_B); // Clear interrupt flags
         }
 
-        // Clear interrupt flags for both buttons
-        *GPEDS0 = (1 << BTN_A) | (1 << BTN_B); // Clear interrupt flags
+        // Signal end of interrupt
+        *GIC_GICC_EOIR = ack; // End interrupt
     }
-
-    // Signal end of interrupt
-    *GIC_GICC_EOIR = ack; // End interrupt
 }
 
 /* GPIO Interrupt Configurations */
@@ -193,9 +205,14 @@ void configure_GPIO_as_output(unsigned int pin)
     // Configure a GPIO pin as output by setting its function bits
     volatile unsigned int *gpio_reg = GPFSEL0 + (pin / 10);
     unsigned int shift = (pin % 10) * 3;
-
-    *gpio_reg &= ~(0x7 << shift);
-    *gpio_reg |= (0x1 << shift);
+    unsigned int r;
+
+    // Read the register once, change the field, and write it back once, so
+    // the pin never passes through the input function on the way
+    r = *gpio_reg;
+    r &= ~(0x7 << shift);
+    r |= (0x1 << shift);
+    *gpio_reg = r;
 }
 
 // Turn on an LED
@@ -0,0 +1,398 @@
+// The functions in this file measure how long some typical pieces of the
+// program take to run, counted in CPU clock cycles using the PMU cycle counter
+// (PMCCNTR_EL0). They are only compiled into the program when it is built
+// using 'make bench', which defines the BENCHMARK symbol. In that case the
+// startup code leaves the MMU and caches off, so that we can first measure
+// the program running uncached, then turn the caches on and measure again.
+//
+// The results are written to the console in hexadecimal, as follows:
+//
+//   memory loop:      <uncached cycles>  <cached cycles>
+//   uart_puthex:      <uncached cycles>  <cached cycles>
+//   IRQ entry:        <uncached cycles>  <cached cycles>
+//   IRQ round trip:   <uncached cycles>  <cached cycles>
+//   FIQ entry:        <uncached cycles>  <cached cycles>
+//   FIQ round trip:   <uncached cycles>  <cached cycles>
+//
+// followed by the number of UART status register reads (each one an uncached
+// MMIO read) and the number of cycles needed to send a short burst of bytes,
+// first one byte at a time using uart_putc(), then using uart_write(). Last
+// comes the ARM generic timer frequency, as given by CNTFRQ_EL0 and as measured
+// against the BCM System Timer (0 under Qemu).
+//
+// The IRQ rows time a software generated interrupt that the core sends to
+// itself: from the write to the GIC until its handler starts, and until the
+// interrupted code carries on. They include the GIC's own latency, as well as
+// the vector in startV2.s and IRQ_handler(). The FIQ rows do the same for a
+// second one routed to FIQ, which goes through the FIQ stub instead. They are
+// replaced by a note if the GIC cannot route it (see fiq_register()), which
+// is the case when the firmware starts the program in the Non-secure state.
+
+#ifdef BENCHMARK
+
+// Header files
+#include "uart.h"
+#include "mmu.h"
+#include "sysreg.h"
+#include "timebase.h"
+#include "gic.h"
+#include "bench.h"
+
+// The burst of bytes sent by the UART benchmark. With the carriage return
+// that goes before the newline, it is 8 bytes long, which fits into the empty
+// Mini UART transmit FIFO.
+#define BURST_STRING            "ABCDEF\n"
+#define BURST_BYTES             8
+
+// The number of 32-bit words in the buffer used by the memory loop (8 KB),
+// the number of passes made over the buffer, and the number of times each
+// measurement is repeated (we report the fastest)
+#define MEMORY_LOOP_WORDS       2048
+#define MEMORY_LOOP_PASSES      8
+#define BENCH_REPEATS           4
+
+// The software generated interrupts used by the IRQ and FIQ benchmarks, and
+// the value written to GICD_SGIR to send one to the core that writes it
+#define BENCH_SGI_ID            0
+#define BENCH_FIQ_SGI_ID        1
+#define BENCH_SGI_TO_SELF(id)   ((0x2 << 24) | (id))
+
+// The buffer used by the memory loop, and a place to put its result so that
+// the compiler cannot optimize the loop away
+static unsigned int bench_buffer[MEMORY_LOOP_WORDS];
+static volatile unsigned int bench_sink;
+
+// The cycle count when the IRQ benchmark's interrupt is sent, and when its
+// handler starts (0 until then)
+static volatile unsigned long bench_irq_sent;
+static volatile unsigned long bench_irq_taken;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       time_memory_loop
+//
+//  Arguments:      none
+//
+//  Returns:        The number of CPU cycles taken by the fastest run
+//
+//  Description:    This function times a loop that repeatedly reads, modifies,
+//                  and writes every word of an 8 KB buffer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long time_memory_loop()
+{
+    unsigned long start, cycles, best = ~0UL;
+    unsigned int sum;
+    int run, pass, i;
+
+
+    for (run = 0; run < BENCH_REPEATS; run++) {
+        start = getCycleCount();
+
+        sum = 0;
+        for (pass = 0; pass < MEMORY_LOOP_PASSES; pass++) {
+            for (i = 0; i < MEMORY_LOOP_WORDS; i++) {
+                bench_buffer[i] += i;
+                sum += bench_buffer[i];
+            }
+        }
+        bench_sink = sum;
+
+        cycles = getCycleCount() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+
+    return best;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       time_uart_puthex
+//
+//  Arguments:      none
+//
+//  Returns:        The number of CPU cycles taken by the fastest run
+//
+//  Description:    This function times a call to uart_puthex(). We wait for
+//                  the UART transmitter to go idle before each call, so that
+//                  the 8 digits always fit into the empty transmit FIFO and we
+//                  measure the cost of the code rather than the Baud rate.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long time_uart_puthex()
+{
+    unsigned long start, cycles, best = ~0UL;
+    int run;
+
+
+    uart_puts("\nuart_puthex output:  ");
+
+    for (run = 0; run < BENCH_REPEATS; run++) {
+        uart_flush();
+
+        start = getCycleCount();
+        uart_puthex(0x12345678);
+        cycles = getCycleCount() - start;
+
+        uart_putc(' ');
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+
+    uart_puts("\n");
+
+    return best;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       bench_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is the handler for the IRQ benchmark's
+//                  software generated interrupt. It only notes the time.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void bench_irq_handler()
+{
+    bench_irq_taken = getCycleCount();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       time_irq
+//
+//  Arguments:      id:          The software generated interrupt to send
+//                  round_trip:  Where to put the number of CPU cycles taken
+//                               by the fastest run to get back to the
+//                               interrupted code
+//
+//  Returns:        The number of CPU cycles taken by the fastest run to reach
+//                  the interrupt handler
+//
+//  Description:    This function sends a software generated interrupt to
+//                  this core, with IRQs enabled, and times how long it takes
+//                  to reach bench_irq_handler(), and to come back. The GIC
+//                  must already be set up, with bench_irq_handler() registered
+//                  for the interrupt (as an IRQ or FIQ).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long time_irq(unsigned int id, unsigned long *round_trip)
+{
+    unsigned long entry, back, best_entry = ~0UL, best_back = ~0UL;
+    int run;
+
+
+    enableIRQ();
+
+    for (run = 0; run < BENCH_REPEATS; run++) {
+        bench_irq_taken = 0;
+
+        // Send the interrupt, and wait for the handler to run
+        bench_irq_sent = getCycleCount();
+        *GIC_GICD_SGIR = BENCH_SGI_TO_SELF(id);
+        while (bench_irq_taken == 0)
+            ;
+        back = getCycleCount() - bench_irq_sent;
+
+        entry = bench_irq_taken - bench_irq_sent;
+        if (entry < best_entry) {
+            best_entry = entry;
+        }
+        if (back < best_back) {
+            best_back = back;
+        }
+    }
+
+    disableIRQ();
+
+    *round_trip = best_back;
+    return best_entry;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       bench_uart_bursts
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sends the same burst of bytes twice: first
+//                  one character at a time using uart_putc() (which is how
+//                  uart_puts() used to work), and then with a single call to
+//                  uart_write(). It prints out the number of status register
+//                  reads and the number of cycles used by each method.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void bench_uart_bursts()
+{
+    struct uart_stats before, after;
+    unsigned long start, putc_cycles, write_cycles;
+    unsigned int putc_reads, write_reads;
+    char *s;
+
+
+    // Send the burst one character at a time, adding a carriage return before
+    // the newline
+    uart_flush();
+    uart_get_stats(&before);
+    start = getCycleCount();
+    for (s = BURST_STRING; *s; s++) {
+        if (*s == '\n')
+            uart_putc('\r');
+        uart_putc(*s);
+    }
+    putc_cycles = getCycleCount() - start;
+    uart_get_stats(&after);
+    putc_reads = after.mmio_reads - before.mmio_reads;
+
+    // Send the same burst using uart_write()
+    uart_flush();
+    uart_get_stats(&before);
+    start = getCycleCount();
+    uart_write(BURST_STRING, BURST_BYTES - 1);
+    write_cycles = getCycleCount() - start;
+    uart_get_stats(&after);
+    write_reads = after.mmio_reads - before.mmio_reads;
+
+    // Print out the results
+    uart_puts("\nSending 0x");
+    uart_puthex(BURST_BYTES);
+    uart_puts(" bytes:  MMIO reads  cycles\n");
+    uart_puts("  uart_putc loop:    0x");
+    uart_puthex(putc_reads);
+    uart_puts("  0x");
+    uart_puthex(putc_cycles);
+    uart_puts("\n  uart_write:        0x");
+    uart_puthex(write_reads);
+    uart_puts("  0x");
+    uart_puthex(write_cycles);
+    uart_puts("\n\n");
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       bench_run
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function runs each benchmark with the caches off,
+//                  turns on the MMU and caches, runs each benchmark again, and
+//                  then prints out a comparison table. It then runs the UART
+//                  burst benchmark and calibrates the timebase. The UART and
+//                  timebase must already be initialized, and the UART must
+//                  not yet be in interrupt-driven mode. The GIC is set up
+//                  here for the IRQ benchmark, and IRQs are left disabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void bench_run()
+{
+    unsigned long uncached_memory, uncached_puthex;
+    unsigned long uncached_irq_entry, uncached_irq_return;
+    unsigned long cached_memory, cached_puthex;
+    unsigned long cached_irq_entry, cached_irq_return;
+    unsigned long uncached_fiq_entry, uncached_fiq_return;
+    unsigned long cached_fiq_entry, cached_fiq_return;
+    int fiq;
+    unsigned long reported_frequency;
+
+
+    // Start the cycle counter
+    enableCycleCounter();
+
+    // Set up the GIC, and the handler for the IRQ benchmark's interrupt
+    gic_init();
+    irq_register(BENCH_SGI_ID, bench_irq_handler, GIC_DEFAULT_PRIORITY,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_EDGE);
+    fiq = fiq_register(BENCH_FIQ_SGI_ID, bench_irq_handler, GIC_TARGET_CORE0,
+                       GIC_GICD_ICFGR_EDGE);
+
+    // Measure with the MMU and caches off
+    uncached_memory = time_memory_loop();
+    uncached_puthex = time_uart_puthex();
+    uncached_irq_entry = time_irq(BENCH_SGI_ID, &uncached_irq_return);
+    if (fiq) {
+        uncached_fiq_entry = time_irq(BENCH_FIQ_SGI_ID, &uncached_fiq_return);
+    }
+
+    // Turn on the MMU and caches, and measure again
+    mmu_enable();
+    cached_memory = time_memory_loop();
+    cached_puthex = time_uart_puthex();
+    cached_irq_entry = time_irq(BENCH_SGI_ID, &cached_irq_return);
+    if (fiq) {
+        cached_fiq_entry = time_irq(BENCH_FIQ_SGI_ID, &cached_fiq_return);
+    }
+
+    // Print out the results
+    uart_puts("\nCycle counts:        caches off  caches on\n");
+    uart_puts("  memory loop:       0x");
+    uart_puthex(uncached_memory);
+    uart_puts("  0x");
+    uart_puthex(cached_memory);
+    uart_puts("\n  uart_puthex:       0x");
+    uart_puthex(uncached_puthex);
+    uart_puts("  0x");
+    uart_puthex(cached_puthex);
+    uart_puts("\n  IRQ entry:         0x");
+    uart_puthex(uncached_irq_entry);
+    uart_puts("  0x");
+    uart_puthex(cached_irq_entry);
+    uart_puts("\n  IRQ round trip:    0x");
+    uart_puthex(uncached_irq_return);
+    uart_puts("  0x");
+    uart_puthex(cached_irq_return);
+    if (fiq) {
+        uart_puts("\n  FIQ entry:         0x");
+        uart_puthex(uncached_fiq_entry);
+        uart_puts("  0x");
+        uart_puthex(cached_fiq_entry);
+        uart_puts("\n  FIQ round trip:    0x");
+        uart_puthex(uncached_fiq_return);
+        uart_puts("  0x");
+        uart_puthex(cached_fiq_return);
+    } else {
+        uart_puts("\n  FIQ:               not available (Non-secure state)");
+    }
+    uart_puts("\n\n");
+
+    // Compare sending a burst of bytes one at a time and all at once
+    bench_uart_bursts();
+
+    // Check the generic timer frequency against the BCM System Timer
+    reported_frequency = timebase_frequency();
+    uart_puts("Counter frequency:   CNTFRQ 0x");
+    uart_puthex(reported_frequency);
+    uart_puts("  measured 0x");
+    uart_puthex(timebase_calibrate());
+    uart_puts("\n\n");
+}
+
+#endif
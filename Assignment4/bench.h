@@ -0,0 +1,4 @@
+// These are the function prototypes for the benchmarks that are built into
+// the program when it is compiled using 'make bench'
+
+void bench_run();
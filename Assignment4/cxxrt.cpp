@@ -0,0 +1,255 @@
+// The functions in this file are the parts of the C++ runtime that C++ code
+// in this program needs: operator new and delete, which allocate from the
+// heap set aside in link.ld, and the stubs that the compiler calls for local
+// static objects, pure virtual functions, and global objects with
+// destructors. The constructors of global objects are called from startV2.s,
+// before main().
+//
+// The program is built without exceptions or run-time type information
+// (-fno-exceptions -fno-rtti), so nothing here throws: running out of memory
+// stops the program instead.
+
+// Header files
+extern "C" {
+#include "sysreg.h"
+}
+
+// The start and end of the heap (see link.ld)
+extern "C" char __heap_start[], __heap_end[];
+
+// A block of heap memory. The header takes 16 bytes, so that the memory
+// after it is aligned for any type. Free blocks are kept in a list, in
+// address order, so that neighbouring free blocks can be joined together.
+struct heap_block {
+    unsigned long size;             // Including this header
+    heap_block *next;               // Next free block (free blocks only)
+};
+
+#define HEAP_ALIGN              16
+#define HEAP_HEADER             sizeof(heap_block)
+#define HEAP_MIN_BLOCK          (HEAP_HEADER + HEAP_ALIGN)
+
+static heap_block *free_list;
+static int heap_ready = 0;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       heap_alloc
+//
+//  Arguments:      size:    The number of bytes wanted
+//
+//  Returns:        A pointer to the memory, or 0 if there is not enough
+//
+//  Description:    This function allocates memory from the heap, using the
+//                  first free block that is big enough, and splitting off the
+//                  rest of the block if it is worth keeping. IRQs are
+//                  disabled while the free list is changed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void *heap_alloc(unsigned long size)
+{
+    heap_block **link, *block, *rest;
+    unsigned long needed;
+    unsigned int irq_masked;
+    void *p = 0;
+
+
+    needed = (size + HEAP_HEADER + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    // The whole heap starts as a single free block
+    if (!heap_ready) {
+        free_list = (heap_block *)__heap_start;
+        free_list->size = __heap_end - __heap_start;
+        free_list->next = 0;
+        heap_ready = 1;
+    }
+
+    for (link = &free_list; *link != 0; link = &(*link)->next) {
+        block = *link;
+        if (block->size < needed) {
+            continue;
+        }
+
+        // Split the block if what is left over can hold a block of its own
+        if (block->size - needed >= HEAP_MIN_BLOCK) {
+            rest = (heap_block *)((char *)block + needed);
+            rest->size = block->size - needed;
+            rest->next = block->next;
+            block->size = needed;
+            *link = rest;
+        } else {
+            *link = block->next;
+        }
+
+        p = (char *)block + HEAP_HEADER;
+        break;
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+
+    return p;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       heap_free
+//
+//  Arguments:      p:       Memory returned by heap_alloc(), or 0
+//
+//  Returns:        void
+//
+//  Description:    This function puts a block back on the free list, in
+//                  address order, and joins it to the free blocks on either
+//                  side of it if they touch.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void heap_free(void *p)
+{
+    heap_block **link, *block, *prev = 0;
+    unsigned int irq_masked;
+
+
+    if (p == 0) {
+        return;
+    }
+    block = (heap_block *)((char *)p - HEAP_HEADER);
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    // Find where the block goes in the list
+    for (link = &free_list; *link != 0 && *link < block;
+         link = &(*link)->next) {
+        prev = *link;
+    }
+    block->next = *link;
+    *link = block;
+
+    // Join it to the block after it, and to the block before it
+    if (block->next != 0 &&
+        (char *)block + block->size == (char *)block->next) {
+        block->size += block->next->size;
+        block->next = block->next->next;
+    }
+    if (prev != 0 && (char *)prev + prev->size == (char *)block) {
+        prev->size += block->size;
+        prev->next = block->next;
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       cxx_halt
+//
+//  Arguments:      none
+//
+//  Returns:        Never
+//
+//  Description:    This function stops the program, when the heap is used up
+//                  or a pure virtual function is called. It is kept as a
+//                  separate function so that a debugger can stop on it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void cxx_halt() __attribute__((noreturn, noinline));
+
+static void cxx_halt()
+{
+    disableIRQ();
+    while (1) {
+    }
+}
+
+
+
+// operator new and delete, in all the forms the compiler may call. Without
+// exceptions, new cannot report failure, so it halts instead.
+void *operator new(unsigned long size)
+{
+    void *p = heap_alloc(size);
+
+    if (p == 0) {
+        cxx_halt();
+    }
+    return p;
+}
+
+void *operator new[](unsigned long size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    heap_free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    heap_free(p);
+}
+
+void operator delete(void *p, unsigned long) noexcept
+{
+    heap_free(p);
+}
+
+void operator delete[](void *p, unsigned long) noexcept
+{
+    heap_free(p);
+}
+
+
+
+extern "C" {
+
+// Local static objects are constructed on first use, between these calls.
+// The first byte of the guard is set once the object has been constructed.
+// The program only constructs them on core 0, so no locking is needed.
+int __cxa_guard_acquire(long long *guard)
+{
+    return *(volatile char *)guard == 0;
+}
+
+void __cxa_guard_release(long long *guard)
+{
+    *(volatile char *)guard = 1;
+}
+
+void __cxa_guard_abort(long long *guard)
+{
+}
+
+// Called if a pure virtual function is somehow called
+void __cxa_pure_virtual()
+{
+    cxx_halt();
+}
+
+// Global objects with destructors register them here. main() never returns,
+// so they are never run, and need not be recorded.
+void *__dso_handle = 0;
+
+int __cxa_atexit(void (*destructor)(void *), void *arg, void *dso)
+{
+    return 0;
+}
+
+}
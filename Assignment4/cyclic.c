@@ -0,0 +1,212 @@
+// The functions in this file implement a simple cyclic executive. The main loop
+// calls cyclic_wait() at the top of each pass (a "frame"), which sleeps until
+// the frame's release time, start + k * period. Since release times are
+// worked out from the start time rather than from the end of the previous
+// frame, the rate does not drift, however long each frame's work takes.
+//
+// If a frame's work runs past the next release time, that is counted as an
+// overrun, and the next frame is released at once, late. If it runs past
+// several release times, the frames in between are skipped (and counted),
+// rather than being run back to back to catch up.
+//
+// The lateness of each release (the time from its release time to when
+// cyclic_wait() returned) is recorded as a minimum, maximum, and mean, and in
+// a histogram with power-of-two buckets. The period jitter, how far the time
+// between one release and the next was from the period (or from the right
+// number of periods, if frames were skipped), is recorded as a maximum and
+// mean. These can be written to the console with cyclic_dump().
+
+// Header files
+#include "cyclic.h"
+#include "timebase.h"
+#include "uart.h"
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       cyclic_init
+//
+//  Arguments:      c:       The cyclic executive to set up
+//                  rate:    The number of frames per second (1 to 1000000)
+//
+//  Returns:        void
+//
+//  Description:    This function sets up a cyclic executive whose first frame
+//                  is released now, and clears its statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void cyclic_init(struct cyclic *c, unsigned int rate)
+{
+    int i;
+
+
+    c->start = now_us();
+    c->period = 1000000 / rate;
+    c->next = 0;
+
+    c->frames = 0;
+    c->overruns = 0;
+    c->skipped = 0;
+    c->lateness_min = ~0UL;
+    c->lateness_max = 0;
+    c->lateness_sum = 0;
+    for (i = 0; i < CYCLIC_HISTOGRAM_BUCKETS; i++) {
+        c->histogram[i] = 0;
+    }
+
+    c->intervals = 0;
+    c->jitter_max = 0;
+    c->jitter_sum = 0;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       cyclic_wait
+//
+//  Arguments:      c:       The cyclic executive
+//
+//  Returns:        void
+//
+//  Description:    This function sleeps until the release time of the next
+//                  frame, and records how late the release was, and how far
+//                  the time since the last release was from the period. If
+//                  the previous frame overran, it returns at once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void cyclic_wait(struct cyclic *c)
+{
+    unsigned long release, current_time, late_frame, lateness;
+    unsigned long interval, expected, jitter;
+    int bucket;
+
+
+    release = c->start + c->next * c->period;
+    current_time = now_us();
+
+    // Check whether the previous frame's work ran past this release time
+    if (c->next > 0 && current_time > release) {
+        c->overruns++;
+
+        // Skip any frames whose release time has also gone by, and release the
+        // most recent one instead
+        late_frame = (current_time - c->start) / c->period;
+        if (late_frame > c->next) {
+            c->skipped += late_frame - c->next;
+            c->next = late_frame;
+            release = c->start + c->next * c->period;
+        }
+    }
+
+    // Sleep until the release time
+    sleep_until_us(release);
+    current_time = now_us();
+
+    // Record how late the release was
+    lateness = current_time - release;
+    if (lateness < c->lateness_min) {
+        c->lateness_min = lateness;
+    }
+    if (lateness > c->lateness_max) {
+        c->lateness_max = lateness;
+    }
+    c->lateness_sum += lateness;
+
+    bucket = lateness ? 64 - __builtin_clzl(lateness) : 0;
+    if (bucket >= CYCLIC_HISTOGRAM_BUCKETS) {
+        bucket = CYCLIC_HISTOGRAM_BUCKETS - 1;
+    }
+    c->histogram[bucket]++;
+
+    // Record how far the time since the last release was from the period
+    if (c->frames > 0) {
+        interval = current_time - c->last_release;
+        expected = (c->next - c->last_frame) * c->period;
+        if (interval > expected) {
+            jitter = interval - expected;
+        } else {
+            jitter = expected - interval;
+        }
+        if (jitter > c->jitter_max) {
+            c->jitter_max = jitter;
+        }
+        c->jitter_sum += jitter;
+        c->intervals++;
+    }
+
+    c->last_frame = c->next;
+    c->last_release = current_time;
+    c->next++;
+    c->frames++;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       cyclic_dump
+//
+//  Arguments:      c:       The cyclic executive
+//
+//  Returns:        void
+//
+//  Description:    This function writes the statistics to the console. All
+//                  values are in hexadecimal, and times are in microseconds.
+//                  Each histogram line gives the lowest lateness counted in
+//                  the bucket, and the number of releases in it. The period
+//                  jitter follows the histogram.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void cyclic_dump(struct cyclic *c)
+{
+    int i;
+
+
+    uart_puts("\nperiod:     0x");
+    uart_puthex(c->period);
+    uart_puts("\nframes:     0x");
+    uart_puthex(c->frames);
+    uart_puts("\noverruns:   0x");
+    uart_puthex(c->overruns);
+    uart_puts("\nskipped:    0x");
+    uart_puthex(c->skipped);
+
+    if (c->frames == 0) {
+        uart_puts("\n");
+        return;
+    }
+
+    uart_puts("\nlateness min: 0x");
+    uart_puthex(c->lateness_min);
+    uart_puts("  max: 0x");
+    uart_puthex(c->lateness_max);
+    uart_puts("  mean: 0x");
+    uart_puthex(c->lateness_sum / c->frames);
+    uart_puts("\n");
+
+    for (i = 0; i < CYCLIC_HISTOGRAM_BUCKETS; i++) {
+        if (c->histogram[i] == 0) {
+            continue;
+        }
+        uart_puts("  >= 0x");
+        uart_puthex(i ? 1 << (i - 1) : 0);
+        uart_puts(": 0x");
+        uart_puthex(c->histogram[i]);
+        uart_puts("\n");
+    }
+
+    if (c->intervals == 0) {
+        return;
+    }
+
+    uart_puts("jitter max: 0x");
+    uart_puthex(c->jitter_max);
+    uart_puts("  mean: 0x");
+    uart_puthex(c->jitter_sum / c->intervals);
+    uart_puts("\n");
+}
@@ -0,0 +1,42 @@
+// These are the definitions and function prototypes for the cyclic executive,
+// which releases the main loop at a fixed rate (see cyclic.c)
+
+#ifndef CYCLIC_H
+#define CYCLIC_H
+
+// The number of buckets in the release lateness histogram. Bucket 0 counts
+// releases that were less than 1 microsecond late, and bucket n (n > 0) those
+// that were 2^(n-1) to 2^n - 1 microseconds late. The last bucket also counts
+// anything later.
+#define CYCLIC_HISTOGRAM_BUCKETS    16
+
+// The state of a cyclic executive, and its statistics
+struct cyclic {
+    unsigned long start;            // Release time of frame 0 (see now_us())
+    unsigned long period;           // Time between releases, in microseconds
+    unsigned long next;             // Number of the next frame to release
+
+    unsigned long frames;           // Frames released
+    unsigned long overruns;         // Frames whose work ran past the next
+                                    // release time
+    unsigned long skipped;          // Frames not released at all, because
+                                    // an overrun went past their release time
+    unsigned long lateness_min;     // Release lateness (time from the
+    unsigned long lateness_max;     // release time to the release), in
+    unsigned long lateness_sum;     // microseconds
+    unsigned int histogram[CYCLIC_HISTOGRAM_BUCKETS];
+
+    unsigned long last_frame;       // Number and time of the last frame
+    unsigned long last_release;     // released
+    unsigned long intervals;        // Times between releases measured
+    unsigned long jitter_max;       // Period jitter (how far the time between
+    unsigned long jitter_sum;       // releases was from the period, in
+                                    // either direction), in microseconds
+};
+
+// Function prototypes
+void cyclic_init(struct cyclic *c, unsigned int rate);
+void cyclic_wait(struct cyclic *c);
+void cyclic_dump(struct cyclic *c);
+
+#endif
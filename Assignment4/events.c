@@ -0,0 +1,336 @@
+// The functions in this file turn successive samples of the SNES controller's
+// buttons into events, so that the host receives ready-made commands rather
+// than raw button masks:
+//
+//   press <button>          A button was pressed
+//   release <button>        A button was released
+//   repeat <button>         A button is being held down (auto-repeat)
+//   chord <button>+<button> Several buttons were pressed together
+//
+// Auto-repeat applies to the most recently pressed of a configurable set of
+// buttons (by default the D-pad): after an initial delay, a repeat event is
+// sent at a fixed rate for as long as the button is held. Repeats are checked
+// each time a sample is taken, so their timing is rounded to the sampling
+// period.
+//
+// A chord is a combination of buttons, such as Start+Select, that means
+// something different from the buttons pressed on their own. Since the
+// buttons of a chord are never pressed at exactly the same moment, a press of
+// a button that belongs to a chord is held back for CHORD_WINDOW. If the rest
+// of the chord is pressed within that time, the chord event is sent instead,
+// and the held back buttons send no press or release events. Otherwise the
+// held back press is sent late.
+
+// Header files
+#include "events.h"
+#include "uart.h"
+
+// How long a press of a chord button is held back, in microseconds
+#define CHORD_WINDOW            60000
+
+// The default auto-repeat settings, in microseconds
+#define REPEAT_DELAY            400000
+#define REPEAT_RATE             100000
+
+// The chords that are recognized
+static const unsigned short chords[] = {
+    SNES_START | SNES_SELECT,
+    SNES_L | SNES_R
+};
+#define NUM_CHORDS              (sizeof(chords) / sizeof(chords[0]))
+
+// The names of the buttons, in bit order
+static char *button_names[16] = {
+    "b", "y", "select", "start", "up", "down", "left", "right",
+    "a", "x", "l", "r", "?", "?", "?", "?"
+};
+
+// The auto-repeat settings
+static unsigned short repeat_buttons = SNES_DPAD;
+static unsigned int repeat_delay = REPEAT_DELAY;
+static unsigned int repeat_rate = REPEAT_RATE;
+
+// The state of the event generator
+static unsigned short previous;         // Buttons in the previous sample
+static unsigned short chord_buttons;    // Buttons that belong to a chord
+static unsigned short held_back;        // Presses not yet sent
+static unsigned long held_since;        // When the first of them happened
+static unsigned short in_chord;         // Buttons used up by a chord
+static unsigned short repeating;        // Button being repeated, or 0
+static unsigned long next_repeat;       // When to send its next repeat
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       add_event
+//
+//  Arguments:      events:     The array of events
+//                  count:      The number of events in the array so far
+//                  type:       The type of the new event
+//                  buttons:    Its button or buttons
+//                  timestamp:  Its time
+//
+//  Returns:        The new number of events
+//
+//  Description:    This function adds an event to the end of the array.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static int add_event(struct snes_event *events, int count, unsigned int type,
+                     unsigned short buttons, unsigned long timestamp)
+{
+    if (count < EVENTS_MAX) {
+        events[count].type = type;
+        events[count].buttons = buttons;
+        events[count].timestamp = timestamp;
+        count++;
+    }
+
+    return count;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       start_repeat
+//
+//  Arguments:      button:     A button that has just been reported pressed
+//                  timestamp:  The time
+//
+//  Returns:        void
+//
+//  Description:    This function starts auto-repeating the button, if it is
+//                  one of the buttons that repeat.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void start_repeat(unsigned short button, unsigned long timestamp)
+{
+    if (button & repeat_buttons) {
+        repeating = button;
+        next_repeat = timestamp + repeat_delay;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       events_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function resets the event generator, as if no buttons
+//                  were pressed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void events_init()
+{
+    unsigned int i;
+
+
+    previous = 0;
+    held_back = 0;
+    in_chord = 0;
+    repeating = 0;
+
+    chord_buttons = 0;
+    for (i = 0; i < NUM_CHORDS; i++) {
+        chord_buttons |= chords[i];
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       events_set_repeat
+//
+//  Arguments:      buttons:  The buttons that auto-repeat (0 for none)
+//                  delay:    Microseconds from the press to the first repeat
+//                  rate:     Microseconds between repeats
+//
+//  Returns:        void
+//
+//  Description:    This function changes the auto-repeat settings.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void events_set_repeat(unsigned short buttons, unsigned int delay,
+                       unsigned int rate)
+{
+    repeat_buttons = buttons;
+    repeat_delay = delay;
+    repeat_rate = rate;
+
+    if (!(repeating & buttons)) {
+        repeating = 0;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       events_update
+//
+//  Arguments:      buttons:    The latest sample of the buttons (a 1 bit for
+//                              each button pressed)
+//                  timestamp:  The time of the sample, in microseconds
+//                  events:     An array of EVENTS_MAX events, into which the
+//                              new events are written
+//
+//  Returns:        The number of new events
+//
+//  Description:    This function compares the sample with the previous one,
+//                  and works out which events have happened since then.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int events_update(unsigned short buttons, unsigned long timestamp,
+                  struct snes_event *events)
+{
+    unsigned short pressed, released, bit;
+    unsigned int i;
+    int count = 0;
+
+
+    pressed = buttons & ~previous;
+    released = previous & ~buttons;
+    previous = buttons;
+
+    // Handle the buttons that have been released
+    for (bit = 1; released; bit <<= 1) {
+        if (!(released & bit)) {
+            continue;
+        }
+        released &= ~bit;
+
+        if (held_back & bit) {
+            // Pressed and released within the chord window, so it was a tap
+            held_back &= ~bit;
+            count = add_event(events, count, EVENT_PRESS, bit, timestamp);
+            count = add_event(events, count, EVENT_RELEASE, bit, timestamp);
+        } else if (in_chord & bit) {
+            // The buttons of a chord are released silently
+            in_chord &= ~bit;
+        } else {
+            count = add_event(events, count, EVENT_RELEASE, bit, timestamp);
+        }
+
+        if (repeating == bit) {
+            repeating = 0;
+        }
+    }
+
+    // Handle the buttons that have been pressed. Presses of buttons that
+    // belong to a chord are held back for a while.
+    for (bit = 1; pressed; bit <<= 1) {
+        if (!(pressed & bit)) {
+            continue;
+        }
+        pressed &= ~bit;
+
+        if (bit & chord_buttons) {
+            if (!held_back) {
+                held_since = timestamp;
+            }
+            held_back |= bit;
+        } else {
+            count = add_event(events, count, EVENT_PRESS, bit, timestamp);
+            start_repeat(bit, timestamp);
+        }
+    }
+
+    // Send a chord event when all of a chord's buttons are down, and at least
+    // one of them has not been reported yet
+    for (i = 0; i < NUM_CHORDS; i++) {
+        if ((buttons & chords[i]) == chords[i] && (held_back & chords[i])) {
+            count = add_event(events, count, EVENT_CHORD, chords[i],
+                              timestamp);
+            in_chord |= held_back & chords[i];
+            held_back &= ~chords[i];
+            if (repeating & chords[i]) {
+                repeating = 0;
+            }
+        }
+    }
+
+    // Send any held back presses whose chord window has run out
+    if (held_back && timestamp - held_since >= CHORD_WINDOW) {
+        for (bit = 1; held_back; bit <<= 1) {
+            if (held_back & bit) {
+                held_back &= ~bit;
+                count = add_event(events, count, EVENT_PRESS, bit, timestamp);
+                start_repeat(bit, timestamp);
+            }
+        }
+    }
+
+    // Send an auto-repeat event if one is due. If samples have been missed,
+    // the repeats that were due are not all sent at once.
+    if (repeating && timestamp >= next_repeat) {
+        count = add_event(events, count, EVENT_REPEAT, repeating, timestamp);
+        next_repeat += repeat_rate;
+        if (next_repeat <= timestamp) {
+            next_repeat = timestamp + repeat_rate;
+        }
+    }
+
+    return count;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       events_write
+//
+//  Arguments:      event:   The event to write
+//
+//  Returns:        void
+//
+//  Description:    This function writes an event to the console as a line of
+//                  text, such as "press up" or "chord select+start".
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void events_write(const struct snes_event *event)
+{
+    unsigned int i;
+    int first = 1;
+
+
+    switch (event->type) {
+    case EVENT_PRESS:
+        uart_puts("press ");
+        break;
+    case EVENT_RELEASE:
+        uart_puts("release ");
+        break;
+    case EVENT_REPEAT:
+        uart_puts("repeat ");
+        break;
+    default:
+        uart_puts("chord ");
+        break;
+    }
+
+    // Write the names of the buttons, separated by '+'
+    for (i = 0; i < 16; i++) {
+        if (event->buttons & (0x1 << i)) {
+            if (!first) {
+                uart_puts("+");
+            }
+            uart_puts(button_names[i]);
+            first = 0;
+        }
+    }
+
+    uart_puts("\n");
+}
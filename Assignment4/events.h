@@ -0,0 +1,46 @@
+// These are the definitions and function prototypes for turning SNES
+// controller samples into events (see events.c)
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+// The bits of the SNES controller's buttons, as returned by get_SNES()
+#define SNES_B                  (0x1 << 0)
+#define SNES_Y                  (0x1 << 1)
+#define SNES_SELECT             (0x1 << 2)
+#define SNES_START              (0x1 << 3)
+#define SNES_UP                 (0x1 << 4)
+#define SNES_DOWN               (0x1 << 5)
+#define SNES_LEFT               (0x1 << 6)
+#define SNES_RIGHT              (0x1 << 7)
+#define SNES_A                  (0x1 << 8)
+#define SNES_X                  (0x1 << 9)
+#define SNES_L                  (0x1 << 10)
+#define SNES_R                  (0x1 << 11)
+#define SNES_DPAD               (SNES_UP | SNES_DOWN | SNES_LEFT | SNES_RIGHT)
+
+// Types of event
+#define EVENT_PRESS             1       // A button was pressed
+#define EVENT_RELEASE           2       // A button was released
+#define EVENT_REPEAT            3       // A button is still held down
+#define EVENT_CHORD             4       // Several buttons were pressed together
+
+// The most events that events_update() can produce from one sample
+#define EVENTS_MAX              32
+
+// An event
+struct snes_event {
+    unsigned int type;
+    unsigned short buttons;         // The button, or the buttons of a chord
+    unsigned long timestamp;        // Time of the sample, in microseconds
+};
+
+// Function prototypes
+void events_init();
+void events_set_repeat(unsigned short buttons, unsigned int delay,
+                       unsigned int rate);
+int events_update(unsigned short buttons, unsigned long timestamp,
+                  struct snes_event *events);
+void events_write(const struct snes_event *event);
+
+#endif
@@ -0,0 +1,300 @@
+// The functions in this file set up the ARM GIC-400 interrupt controller on the
+// BCM2711, and register handlers for individual interrupt sources in it. The
+// GIC must be turned on in the config.txt file (enable_gic=1), which is the
+// default on the Raspberry Pi 4.
+//
+// The handlers are kept in a table indexed by interrupt ID, so IRQ_handler()
+// (see handlers.c) finds the one to call in a single step, however many are
+// registered. One interrupt can instead be routed to FIQ, which has its own
+// fast path (see fiq_register()).
+//
+// Interrupts are preemptive: the handler of a low-priority interrupt runs
+// with IRQs enabled, and the GIC only signals interrupts in a higher priority
+// group while it does (see GIC_PREEMPTIBLE_PRIORITY in gic.h).
+
+// Header files
+#include "sysreg.h"
+#include "gic.h"
+
+// The handler for each interrupt ID, and its priority
+gic_handler gic_handlers[GIC_IRQS];
+unsigned char gic_priorities[GIC_IRQS];
+
+// The interrupt routed to FIQ, and its handler
+unsigned int gic_fiq_id = GIC_IRQS;
+gic_handler gic_fiq_handler;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       enable_forwarding
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function turns on forwarding of interrupts from the
+//                  distributor to the CPU interface, and signalling of them
+//                  to the core. Once an interrupt has been routed to FIQ,
+//                  Group 0 and Group 1 are both enabled, Group 0 is
+//                  signalled as FIQ, and GICC_IAR acknowledges Group 1
+//                  interrupts for IRQ_handler().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void enable_forwarding()
+{
+    if (gic_fiq_handler != 0) {
+        *GIC_GICD_CTLR = GIC_GICD_CTLR_ENABLE | GIC_GICD_CTLR_ENABLE_GRP1;
+        *GIC_GICC_CTLR = GICC_CTLR_ENABLE | GICC_CTLR_ENABLE_GRP1 |
+                         GICC_CTLR_ACKCTL | GICC_CTLR_FIQEN;
+    } else {
+        *GIC_GICD_CTLR = GIC_GICD_CTLR_ENABLE;
+        *GIC_GICC_CTLR = GICC_CTLR_ENABLE;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       gic_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function turns on forwarding of interrupts from the
+//                  GIC distributor to the CPU interface, and sets the CPU
+//                  interface priority mask so that interrupts of every
+//                  priority are signalled to the core. It also sets the
+//                  binary point, which decides which interrupts can preempt
+//                  each other. IRQ exceptions must still be enabled on the
+//                  core using enableIRQ().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void gic_init()
+{
+    // Let interrupts of all priorities through the CPU interface
+    *GIC_GICC_PMR = GICC_PMR_PRIO_MIN;
+
+    // Use bits 7 - 4 of each priority to decide on preemption
+    *GIC_GICC_BPR = GICC_BPR_GROUP_7_4;
+
+    // Enable forwarding of interrupts from the distributor, and signalling
+    // of them to the core
+    enable_forwarding();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       configure_interrupt
+//
+//  Arguments:      id:        The interrupt ID (0 - 255)
+//                  priority:  Its priority (0 - 255)
+//                  targets:   A bit for each CPU core it is sent to
+//                  trigger:   GIC_GICD_ICFGR_LEVEL or GIC_GICD_ICFGR_EDGE
+//
+//  Returns:        void
+//
+//  Description:    This function sets up an interrupt's priority, targets,
+//                  and trigger in the GIC distributor. The targets and
+//                  trigger of software generated and private peripheral
+//                  interrupts (IDs 0 - 31) are fixed, so they are left alone.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void configure_interrupt(unsigned int id, unsigned int priority,
+                                unsigned int targets, unsigned int trigger)
+{
+    unsigned int shift, r;
+
+
+    // Set the priority of the interrupt. There is one byte per interrupt.
+    *((volatile unsigned char *)GIC_GICD_IPRIORITYR + id) = priority;
+
+    if (id >= 32) {
+        // Choose which cores the interrupt is sent to. There is one byte per
+        // interrupt.
+        *((volatile unsigned char *)GIC_GICD_ITARGETSR + id) = targets;
+
+        // Make the interrupt level-sensitive or edge-triggered. There are 2
+        // bits per interrupt in the configuration registers.
+        shift = (id % 16) * 2;
+        r = *(GIC_GICD_ICFGR + (id / 16));
+        r &= ~(0x3 << shift);
+        r |= ((trigger & 0x3) << shift);
+        *(GIC_GICD_ICFGR + (id / 16)) = r;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       irq_register
+//
+//  Arguments:      id:        The interrupt ID (0 - 255)
+//                  handler:   The function to call for the interrupt
+//                  priority:  Its priority (0 - 255, lower values are higher
+//                             priorities), e.g. GIC_DEFAULT_PRIORITY
+//                  targets:   A bit for each CPU core it is sent to, e.g.
+//                             GIC_TARGET_CORE0
+//                  trigger:   GIC_GICD_ICFGR_LEVEL or GIC_GICD_ICFGR_EDGE
+//
+//  Returns:        1 if the handler was registered, or 0 if the interrupt ID
+//                  is out of range
+//
+//  Description:    This function records the handler for an interrupt, sets
+//                  up the interrupt's priority, targets, and trigger in the
+//                  GIC distributor, and then enables it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int irq_register(unsigned int id, gic_handler handler, unsigned int priority,
+                 unsigned int targets, unsigned int trigger)
+{
+    if (id >= GIC_IRQS) {
+        return 0;
+    }
+
+    // Record the handler before the interrupt can be taken
+    gic_handlers[id] = handler;
+    gic_priorities[id] = priority;
+
+    configure_interrupt(id, priority, targets, trigger);
+
+    // Enable the interrupt. There is 1 bit per interrupt.
+    *(GIC_GICD_ISENABLER + (id / 32)) = (0x1 << (id % 32));
+
+    return 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       gic_disable
+//
+//  Arguments:      id:        The interrupt ID (0 - 1019)
+//
+//  Returns:        void
+//
+//  Description:    This function disables an interrupt in the GIC
+//                  distributor. It is used for interrupts with no handler,
+//                  by IRQ_handler() and by the FIQ stub in startV2.s, since
+//                  nothing would clear their cause, and they would otherwise
+//                  be taken again straight away.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void gic_disable(unsigned int id)
+{
+    // There is 1 bit per interrupt
+    *(GIC_GICD_ICENABLER + (id / 32)) = (0x1 << (id % 32));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       gic_fiq_available
+//
+//  Arguments:      none
+//
+//  Returns:        1 if an interrupt can be routed to FIQ, 0 if it cannot
+//
+//  Description:    This function finds out whether we can change the group of
+//                  an interrupt. Only Group 0 interrupts can be signalled as
+//                  FIQ, and the group registers can only be written from the
+//                  Secure state. The Pi 4's firmware starts the program in
+//                  the Non-secure state, where the group registers read as
+//                  zero and ignore writes, so we try moving SGI 0 to Group 1
+//                  and see whether it stays there.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int gic_fiq_available()
+{
+    unsigned int saved, available;
+
+
+    saved = *GIC_GICD_IGROUPR;
+    *GIC_GICD_IGROUPR = saved | 0x1;
+    available = *GIC_GICD_IGROUPR & 0x1;
+    *GIC_GICD_IGROUPR = saved;
+
+    return available;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       fiq_register
+//
+//  Arguments:      id:        The interrupt ID (0 - 255)
+//                  handler:   The function to call for the interrupt
+//                  targets:   A bit for each CPU core it is sent to, e.g.
+//                             GIC_TARGET_CORE0
+//                  trigger:   GIC_GICD_ICFGR_LEVEL or GIC_GICD_ICFGR_EDGE
+//
+//  Returns:        1 if the interrupt was routed to FIQ, or 0 if it was not
+//                  because the interrupt ID is out of range, another
+//                  interrupt already uses FIQ, or the GIC does not let us
+//                  (see gic_fiq_available())
+//
+//  Description:    This function routes one interrupt to FIQ, so that its
+//                  handler is called straight from the FIQ stub in startV2.s,
+//                  and can preempt any IRQ handler. It puts the interrupt in
+//                  Group 0, with the highest priority, and every other
+//                  interrupt in Group 1, which is still signalled as IRQ. FIQs
+//                  are then enabled on the core.
+//
+//                  The handler runs even while IRQs are masked, so it must not
+//                  share data with other code unless that code masks FIQs as
+//                  well. It is also recorded as the interrupt's IRQ handler,
+//                  in case IRQ_handler() acknowledges the interrupt before
+//                  the FIQ is taken. If 0 is returned, the caller can use
+//                  irq_register() with GIC_PRIORITY_HIGH instead.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int fiq_register(unsigned int id, gic_handler handler, unsigned int targets,
+                 unsigned int trigger)
+{
+    unsigned int i;
+
+
+    if (id >= GIC_IRQS || gic_fiq_handler != 0 || !gic_fiq_available()) {
+        return 0;
+    }
+
+    // Record the interrupt and its handler before it can be taken
+    gic_fiq_id = id;
+    gic_fiq_handler = handler;
+    gic_handlers[id] = handler;
+    gic_priorities[id] = GIC_PRIORITY_FIQ;
+
+    // Put this interrupt in Group 0, and all of the others in Group 1.
+    // There is 1 bit per interrupt.
+    for (i = 0; i < GIC_IRQS / 32; i++) {
+        *(GIC_GICD_IGROUPR + i) = 0xFFFFFFFF;
+    }
+    *(GIC_GICD_IGROUPR + (id / 32)) = ~(0x1 << (id % 32));
+
+    configure_interrupt(id, GIC_PRIORITY_FIQ, targets, trigger);
+
+    // Signal Group 0 as FIQ and Group 1 as IRQ
+    enable_forwarding();
+
+    // Enable the interrupt, and then FIQs on the core
+    *(GIC_GICD_ISENABLER + (id / 32)) = (0x1 << (id % 32));
+    enableFIQ();
+
+    return 1;
+}
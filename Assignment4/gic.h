@@ -0,0 +1,155 @@
+// The addresses of the GIC registers.
+//
+// These are defined in sections 4.1.2 and 4.1.3 (p. 4-74 to 4-76) of the ARM
+// Generic Interrupt Controller Architecture Specification (Architecture
+// Version 2.0).
+//
+// The BCM2711 SoC used on the Raspberry Pi 4 contains an ARM GICv2 interrupt
+// controller. To enable the GIC on the Pi, use the following in the config.txt
+// file:  enable_gic=1
+
+
+// Base addresses. In the host build, the GIC is simulated along with the other
+// peripherals (see gpio.h).
+#ifdef HOST
+extern unsigned long sim_mmio_offset;
+#define GIC_BASE			(sim_mmio_offset + 0xff841000)
+#else
+#define GIC_BASE			(0xff841000)         // General GIC base address
+#endif
+#define GIC_GICD_BASE		(GIC_BASE)           // GICD MMIO base address
+#define GIC_GICC_BASE		(GIC_BASE + 0x1000)  // GICC MMIO base address
+
+
+// 4.1.2 The GIC Distributor register map
+#define GIC_GICD_CTLR		((volatile unsigned int *)(GIC_GICD_BASE + 0x000)) // Distributor Control Register
+#define GIC_GICD_TYPER		((volatile unsigned int *)(GIC_GICD_BASE + 0x004)) // Interrupt Controller Type Register
+#define GIC_GICD_IIDR		((volatile unsigned int *)(GIC_GICD_BASE + 0x008)) // Distributor Implementer Identification Register
+#define GIC_GICD_IGROUPR	((volatile unsigned int *)(GIC_GICD_BASE + 0x080)) // Interrupt Group Registers
+#define GIC_GICD_ISENABLER	((volatile unsigned int *)(GIC_GICD_BASE + 0x100)) // Interrupt Set-Enable Registers
+#define GIC_GICD_ICENABLER	((volatile unsigned int *)(GIC_GICD_BASE + 0x180)) // Interrupt Clear-Enable Registers
+#define GIC_GICD_ISPENDR	((volatile unsigned int *)(GIC_GICD_BASE + 0x200)) // Interrupt Set-Pending Registers
+#define GIC_GICD_ICPENDR	((volatile unsigned int *)(GIC_GICD_BASE + 0x280)) // Interrupt Clear-Pending Registers
+#define GIC_GICD_ISACTIVER	((volatile unsigned int *)(GIC_GICD_BASE + 0x300)) // Interrupt Set-Active Registers
+#define GIC_GICD_ICACTIVER	((volatile unsigned int *)(GIC_GICD_BASE + 0x380)) // Interrupt Clear-Active Registers
+#define GIC_GICD_IPRIORITYR	((volatile unsigned int *)(GIC_GICD_BASE + 0x400)) // Interrupt Priority Registers
+#define GIC_GICD_ITARGETSR	((volatile unsigned int *)(GIC_GICD_BASE + 0x800)) // Interrupt Processor Targets Registers
+#define GIC_GICD_ICFGR		((volatile unsigned int *)(GIC_GICD_BASE + 0xc00)) // Interrupt Configuration Registers
+#define GIC_GICD_NSCAR		((volatile unsigned int *)(GIC_GICD_BASE + 0xe00)) // Non-secure Access Control Registers
+#define GIC_GICD_SGIR		((volatile unsigned int *)(GIC_GICD_BASE + 0xf00)) // Software Generated Interrupt Register
+#define GIC_GICD_CPENDSGIR	((volatile unsigned int *)(GIC_GICD_BASE + 0xf10)) // SGI Clear-Pending Registers
+#define GIC_GICD_SPENDSGIR	((volatile unsigned int *)(GIC_GICD_BASE + 0xf20)) // SGI Set-Pending Registers
+
+// 4.3.1 GICD_CTLR, Distributor Control Register
+#define GIC_GICD_CTLR_ENABLE   (0x1)  // Enable GICD interrupt forwarding
+#define GIC_GICD_CTLR_DISABLE  (0x0)  // Disable GICD interrupt forwarding
+#define GIC_GICD_CTLR_ENABLE_GRP1 (0x2)  // Enable Group 1 forwarding (Secure view)
+
+// 4.3.13 GICD_ICFGR<n>, Interrupt Configuration Registers
+#define GIC_GICD_ICFGR_LEVEL   (0x0)  // level-sensitive
+#define GIC_GICD_ICFGR_EDGE    (0x2)  // edge-triggered
+
+
+// 4.1.3 The GIC CPU interface register map
+#define GIC_GICC_CTLR	((volatile unsigned int *)(GIC_GICC_BASE + 0x000))  // CPU Interface Control Register
+#define GIC_GICC_PMR	((volatile unsigned int *)(GIC_GICC_BASE + 0x004))  // Interrupt Priority Mask Register
+#define GIC_GICC_BPR	((volatile unsigned int *)(GIC_GICC_BASE + 0x008))  // Binary Point Register
+#define GIC_GICC_IAR	((volatile unsigned int *)(GIC_GICC_BASE + 0x00C))  // Interrupt Acknowledge Register
+#define GIC_GICC_EOIR	((volatile unsigned int *)(GIC_GICC_BASE + 0x010))  // End of Interrupt Register
+#define GIC_GICC_RPR	((volatile unsigned int *)(GIC_GICC_BASE + 0x014))  // Running Priority Register
+#define GIC_GICC_HPIR	((volatile unsigned int *)(GIC_GICC_BASE + 0x018))  // Highest Priority Pending Interrupt Register
+#define GIC_GICC_ABPR	((volatile unsigned int *)(GIC_GICC_BASE + 0x01C))  // Aliased Binary Point Register
+#define GIC_GICC_AIAR	((volatile unsigned int *)(GIC_GICC_BASE + 0x020))  // Aliased Interrupt Acknowledge Register
+#define GIC_GICC_AEOIR	((volatile unsigned int *)(GIC_GICC_BASE + 0x024))  // Aliased End of Interrupt Register
+#define GIC_GICC_AHPPIR	((volatile unsigned int *)(GIC_GICC_BASE + 0x028))  // Aliased Highest Priority Pending Interrupt Register
+#define GIC_GICC_IIDR	((volatile unsigned int *)(GIC_GICC_BASE + 0x0FC))  // CPU Interface Identification Register
+#define GIC_GICC_DIR	((volatile unsigned int *)(GIC_GICC_BASE + 0x100))  // Deactivate Interrupt Register
+
+// 4.4.1 GICC_CTLR, CPU Interface Control Register
+#define GICC_CTLR_ENABLE		(0x1)			// Enable GICC signaling
+#define GICC_CTLR_DISABLE		(0x0)			// Disable GICC signaling
+#define GICC_CTLR_ENABLE_GRP1	(0x2)			// Signal Group 1 too (Secure view)
+#define GICC_CTLR_ACKCTL		(0x4)			// GICC_IAR acknowledges Group 1 too
+#define GICC_CTLR_FIQEN			(0x8)			// Signal Group 0 as FIQ
+
+// 4.4.2 GICC_PMR, CPU Interface Priority Mask Register
+#define GICC_PMR_PRIO_MIN		(0xff)			// The lowest level mask
+#define GICC_PMR_PRIO_HIGH		(0x00)			// The highest level mask
+
+// 4.4.3 GICC_BPR, Binary Point Register. With a value of 3, bits 7 - 4 of a
+// priority are its group priority, which decides whether an interrupt can
+// preempt a handler, and bits 3 - 0 only order interrupts within a group.
+#define GICC_BPR_GROUP_7_4		(0x3)
+
+// 4.4.4 GICC_IAR, CPU Interface Interrupt Acknowledge Register
+#define GICC_IAR_INTR_IDMASK	(0x3ff)			// Bits 0-9: Interrupt ID
+#define GICC_IAR_SPURIOUS_INTR	(0x3ff)			// 1023 means spurious interrupt
+#define GICC_IAR_CPU_IDMASK		(0x1c00)		// Bits 10-12: CPU ID
+
+
+
+// Interrupt IDs of the BCM2711 peripherals that we use. The VideoCore
+// peripheral interrupts start at ID 96 in the GIC. ID 30 is the private
+// peripheral interrupt of each core's EL1 physical timer. The GPIO interrupts
+// are VideoCore interrupts 49 - 52: one for each of the three banks, and one
+// that is raised for an event on any pin.
+#define GIC_CNTP_IRQ_ID         30      // ARM generic timer (EL1 physical)
+#define GIC_SYSTIMER_C1_IRQ_ID  97      // BCM System Timer compare channel 1
+#define GIC_SYSTIMER_C3_IRQ_ID  99      // BCM System Timer compare channel 3
+#define GIC_AUX_IRQ_ID          125     // Mini UART (and SPI1/SPI2)
+#define GIC_GPIO0_IRQ_ID        145     // GPIO bank 0 (pins 0 - 27)
+#define GIC_GPIO1_IRQ_ID        146     // GPIO bank 1 (pins 28 - 45)
+#define GIC_GPIO2_IRQ_ID        147     // GPIO bank 2 (pins 46 - 57)
+#define GIC_GPIO_ANY_IRQ_ID     148     // Any GPIO pin
+#define GIC_PL011_IRQ_ID        153     // PL011 UART0 (and UART2 - UART5)
+
+// The number of interrupt IDs that handlers can be registered for: the 16
+// software generated interrupts (0 - 15), the 16 private peripheral
+// interrupts (16 - 31), and the BCM2711's shared peripheral interrupts
+#define GIC_IRQS                256
+
+// The priorities that we give to interrupts. Lower values are higher
+// priorities. Each is in a different priority group (see GICC_BPR_GROUP_7_4),
+// so an interrupt can preempt the handler of one with a lower priority, as
+// long as that handler is preemptible.
+#define GIC_PRIORITY_HIGH       0x40    // Short, time-critical handlers
+#define GIC_DEFAULT_PRIORITY    0xA0
+#define GIC_PRIORITY_LOW        0xC0    // Long handlers, e.g. UART draining
+#define GIC_PRIORITY_FIQ        0x00    // The interrupt routed to FIQ
+
+// Handlers of interrupts with this priority or lower run with IRQs enabled,
+// so that higher-priority interrupts can preempt them. Each preempted handler
+// leaves a frame on the exception stack, so this only happens while fewer
+// than GIC_NEST_MAX of them are in progress; beyond that, handlers run with
+// IRQs masked as usual.
+#define GIC_PREEMPTIBLE_PRIORITY GIC_PRIORITY_LOW
+#define GIC_NEST_MAX            4
+
+// Values for the targets of an interrupt: a bit for each CPU core
+#define GIC_TARGET_CORE0        0x1
+
+// The type of an interrupt handler. It is called from IRQ_handler() (see
+// handlers.c) after the interrupt has been acknowledged, and must clear the
+// cause of the interrupt in its device.
+typedef void (*gic_handler)();
+
+// The handler registered for each interrupt ID, or 0 if none has been, and
+// the priority it was registered with
+extern gic_handler gic_handlers[GIC_IRQS];
+extern unsigned char gic_priorities[GIC_IRQS];
+
+// The interrupt routed to FIQ (GIC_IRQS if there is none), and its handler, or
+// 0 if there is none. They are used by the FIQ stub in startV2.s.
+extern unsigned int gic_fiq_id;
+extern gic_handler gic_fiq_handler;
+
+
+//  C language function prototypes for the functions in gic.c
+
+void gic_init();
+int irq_register(unsigned int id, gic_handler handler, unsigned int priority,
+                 unsigned int targets, unsigned int trigger);
+void gic_disable(unsigned int id);
+int gic_fiq_available();
+int fiq_register(unsigned int id, gic_handler handler, unsigned int targets,
+                 unsigned int trigger);
@@ -0,0 +1,84 @@
+// The functions in this file set up the GPIO pins. The inline functions in
+// gpio.h set, clear, and read them.
+
+// Header files
+#include "gpio.h"
+#include "shadow.h"
+
+// The number of Function Select and pull-up/pull-down registers
+#define GPIO_FSEL_REGISTERS     6
+#define GPIO_PULL_REGISTERS     4
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       gpio_configure
+//
+//  Arguments:      table:   An array of pins, each with its function and
+//                           pull-up/pull-down
+//                  count:   The number of entries in the table
+//
+//  Returns:        void
+//
+//  Description:    This function sets the function and pull-up/pull-down of
+//                  every pin in the table. It first works out the new contents
+//                  of each field, so that each Function Select Register (10
+//                  pins, 3 bits per pin) and pull-up/pull-down register (16
+//                  pins, 2 bits per pin) that needs changing is read and
+//                  written only once, however many of its pins are in the
+//                  table. Output pins should be set or cleared before they are
+//                  configured, so that they start at the right level. Entries
+//                  for pins that do not exist (GPIO_PINS or above) are
+//                  ignored.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void gpio_configure(const struct gpio_pin_config *table, unsigned int count)
+{
+    unsigned int fsel_mask[GPIO_FSEL_REGISTERS], fsel[GPIO_FSEL_REGISTERS];
+    unsigned int pull_mask[GPIO_PULL_REGISTERS], pull[GPIO_PULL_REGISTERS];
+    unsigned int i, pin, shift;
+
+
+    for (i = 0; i < GPIO_FSEL_REGISTERS; i++) {
+        fsel_mask[i] = 0;
+        fsel[i] = 0;
+    }
+    for (i = 0; i < GPIO_PULL_REGISTERS; i++) {
+        pull_mask[i] = 0;
+        pull[i] = 0;
+    }
+
+    // Collect the fields to change in each register. If a pin appears more
+    // than once, its last entry wins.
+    for (i = 0; i < count; i++) {
+        pin = table[i].pin;
+        if (pin >= GPIO_PINS) {
+            continue;
+        }
+
+        shift = (pin % 10) * 3;
+        fsel_mask[pin / 10] |= 0x7 << shift;
+        fsel[pin / 10] &= ~(0x7 << shift);
+        fsel[pin / 10] |= (table[i].function & 0x7) << shift;
+
+        shift = (pin % 16) * 2;
+        pull_mask[pin / 16] |= 0x3 << shift;
+        pull[pin / 16] &= ~(0x3 << shift);
+        pull[pin / 16] |= (table[i].pull & 0x3) << shift;
+    }
+
+    // Change each register that holds one of the pins, leaving the fields of
+    // the other pins as they were (see shadow.c)
+    for (i = 0; i < GPIO_FSEL_REGISTERS; i++) {
+        if (fsel_mask[i] != 0) {
+            shadow_modify(SHADOW_GPFSEL0 + i, fsel_mask[i], fsel[i]);
+        }
+    }
+    for (i = 0; i < GPIO_PULL_REGISTERS; i++) {
+        if (pull_mask[i] != 0) {
+            shadow_modify(SHADOW_GPPUPPDN0 + i, pull_mask[i], pull[i]);
+        }
+    }
+}
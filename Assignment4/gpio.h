@@ -9,10 +9,24 @@
 // addresses of the peripherals, which have the address range 0xFE000000 to
 // 0xFEFFFFFF. These addresses are mapped by the VideoCore Memory Management
 // Unit (MMU) onto bus addresses in the range 0x7E000000 to 0x7EFFFFFF.
+//
+// The GPIO functions declared at the end of this file work with any of the 58
+// pins. Pins 0 - 31 are in bank 0, and pins 32 - 57 in bank 1, and each bank
+// has its own set, clear, and level registers (GPSET0 and GPSET1, and so on).
+
+#ifndef GPIO_H
+#define GPIO_H
 
 
-// BCM2711 (Raspberry Pi 4) Memory Mapped I/O base address
+// BCM2711 (Raspberry Pi 4) Memory Mapped I/O base address. In the host build
+// ('make host'), the peripherals are simulated in a block of the process's
+// memory, sim_mmio_offset bytes away from their real addresses (see sim/).
+#ifdef HOST
+extern unsigned long sim_mmio_offset;
+#define MMIO_BASE       (sim_mmio_offset + 0xFE000000)
+#else
 #define MMIO_BASE       0xFE000000
+#endif
 
 // GPIO register addresses
 #define GPFSEL0         ((volatile unsigned int *)(MMIO_BASE + 0x00200000))
@@ -45,3 +59,74 @@
 #define GPPUPPDN1       ((volatile unsigned int *)(MMIO_BASE + 0x002000E8))
 #define GPPUPPDN2       ((volatile unsigned int *)(MMIO_BASE + 0x002000EC))
 #define GPPUPPDN3       ((volatile unsigned int *)(MMIO_BASE + 0x002000F0))
+
+
+
+// The number of GPIO pins, and the bank that holds a pin and the pin's bit in
+// that bank's registers
+#define GPIO_PINS               58
+#define GPIO_BANK(pin)          ((pin) / 32)
+#define GPIO_MASK(pin)          (0x1 << ((pin) % 32))
+
+// Values for a pin's function select field. Note that the alternate functions
+// are not numbered in order.
+#define GPIO_FUNCTION_INPUT     0x0
+#define GPIO_FUNCTION_OUTPUT    0x1
+#define GPIO_FUNCTION_ALT0      0x4
+#define GPIO_FUNCTION_ALT1      0x5
+#define GPIO_FUNCTION_ALT2      0x6
+#define GPIO_FUNCTION_ALT3      0x7
+#define GPIO_FUNCTION_ALT4      0x3
+#define GPIO_FUNCTION_ALT5      0x2
+
+// Values for a pin's pull-up/pull-down field
+#define GPIO_PULL_NONE          0x0
+#define GPIO_PULL_UP            0x1
+#define GPIO_PULL_DOWN          0x2
+
+// One entry of a table of pins for gpio_configure()
+struct gpio_pin_config {
+    unsigned char pin;                  // 0 - 57
+    unsigned char function;             // GPIO_FUNCTION_*
+    unsigned char pull;                 // GPIO_PULL_*
+};
+
+// Drive high (or low) every output pin in a bank whose bit is set in the mask,
+// with a single register write. These are inline, since they are used to
+// bit-bang signals.
+static inline void gpio_set_mask(unsigned int bank, unsigned int mask)
+{
+    *(GPSET0 + bank) = mask;
+}
+
+static inline void gpio_clear_mask(unsigned int bank, unsigned int mask)
+{
+    *(GPCLR0 + bank) = mask;
+}
+
+// Read the levels of all the pins in a bank at once
+static inline unsigned int gpio_read_bank(unsigned int bank)
+{
+    return *(GPLEV0 + bank);
+}
+
+// The same, for a single pin
+static inline void gpio_set(unsigned int pin)
+{
+    gpio_set_mask(GPIO_BANK(pin), GPIO_MASK(pin));
+}
+
+static inline void gpio_clear(unsigned int pin)
+{
+    gpio_clear_mask(GPIO_BANK(pin), GPIO_MASK(pin));
+}
+
+static inline unsigned int gpio_read(unsigned int pin)
+{
+    return (gpio_read_bank(GPIO_BANK(pin)) >> (pin % 32)) & 0x1;
+}
+
+// Function prototypes (see gpio.c)
+void gpio_configure(const struct gpio_pin_config *table, unsigned int count);
+
+#endif
@@ -0,0 +1,92 @@
+// This file contains a C function to handle IRQ exceptions
+
+// Header files
+#include "sysreg.h"
+#include "gic.h"
+#ifdef IRQBENCH
+#include "timebase.h"
+#include "irqbench.h"
+#endif
+
+// The number of handlers that are running with IRQs enabled, and might have
+// been preempted
+static unsigned int nest_depth;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       IRQ_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called from the IRQ exception handler stub
+//                  in startV2.s. It acknowledges the highest priority pending
+//                  interrupt in the GIC, calls the handler registered for it
+//                  (see irq_register() in gic.c), and then signals the end of
+//                  the interrupt. It keeps doing so until the GIC reports a
+//                  spurious interrupt, meaning that none is left pending, so
+//                  that interrupts which arrive together are all handled in
+//                  one exception.
+//
+//                  The handler of an interrupt with a priority of
+//                  GIC_PREEMPTIBLE_PRIORITY or lower is run with IRQs
+//                  enabled, so that an interrupt in a higher priority group
+//                  can preempt it; the IRQ stub has saved ELR_EL1 and
+//                  SPSR_EL1 for this. The GIC keeps signalling only the
+//                  higher groups until the end of the interrupt, and at most
+//                  GIC_NEST_MAX handlers are preempted at once, which bounds
+//                  the exception stack.
+//
+//                  An interrupt with no handler is disabled, since nothing
+//                  would clear its cause, and it would otherwise be taken
+//                  again straight away.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void IRQ_handler()
+{
+    unsigned int ack, interruptID;
+    gic_handler handler;
+
+
+    while (1) {
+        // Acknowledge the interrupt in the GIC. This also retrieves the
+        // Interrupt ID and CPUID
+        ack = *GIC_GICC_IAR;
+
+        // Isolate the Interrupt ID from the raw acknowledge value. IDs 1020 -
+        // 1023 are special, and mean that there is nothing to acknowledge.
+        interruptID = ack & GICC_IAR_INTR_IDMASK;
+        if (interruptID >= 1020) {
+            break;
+        }
+
+        // Call the handler for the interrupt
+        handler = interruptID < GIC_IRQS ? gic_handlers[interruptID] : 0;
+        if (handler != 0 &&
+            gic_priorities[interruptID] >= GIC_PREEMPTIBLE_PRIORITY &&
+            nest_depth < GIC_NEST_MAX) {
+            // Let higher-priority interrupts in while the handler runs
+            nest_depth++;
+            enableIRQ();
+            handler();
+            disableIRQ();
+            nest_depth--;
+        } else if (handler != 0) {
+            handler();
+        } else {
+            gic_disable(interruptID);
+        }
+
+        // Signal end of interrupt to the GIC, with IRQs masked so that no
+        // interrupt of the same priority can come in before we return
+        *GIC_GICC_EOIR = ack;
+#ifdef IRQBENCH
+        // Note the time for the interrupt benchmarks (see irqbench.c)
+        irq_eoi_ticks = timebase_ticks();
+#endif
+    }
+}
@@ -0,0 +1,97 @@
+// A small example program that uses the decoder in snesproto.c. It opens a
+// serial port (default /dev/ttyUSB1 at 115200 Baud), decodes the binary SNES
+// reports sent by the firmware, and prints each one, along with the decoder's
+// error counts when the program is interrupted with Ctrl-C.
+//
+// Usage:  snesdump [device [baud]]
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "snesproto.h"
+
+static volatile sig_atomic_t done;
+
+static void stop(int sig)
+{
+    (void)sig;
+    done = 1;
+}
+
+static speed_t baud_to_speed(long baud)
+{
+    switch (baud) {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+#ifdef B3000000
+    case 3000000: return B3000000;
+#endif
+    default:      return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device = argc > 1 ? argv[1] : "/dev/ttyUSB1";
+    long baud = argc > 2 ? atol(argv[2]) : 115200;
+    struct snes_decoder decoder;
+    struct snes_report report;
+    struct termios tio;
+    uint8_t buf[256];
+    ssize_t n, i;
+    speed_t speed;
+    int fd;
+
+    speed = baud_to_speed(baud);
+    if (speed == 0) {
+        fprintf(stderr, "Unsupported Baud rate: %ld\n", baud);
+        return 1;
+    }
+
+    fd = open(device, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(device);
+        return 1;
+    }
+
+    // Put the serial port into raw mode, so that bytes arrive unchanged
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    signal(SIGINT, stop);
+    snes_decoder_init(&decoder);
+
+    while (!done && (n = read(fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; i++) {
+            if (snes_decoder_feed(&decoder, buf[i], &report)) {
+                printf("seq %3u  buttons 0x%04X  t %10lu us",
+                       report.sequence, report.buttons,
+                       (unsigned long)report.timestamp_us);
+                if (report.dropped) {
+                    printf("  (%u dropped)", report.dropped);
+                }
+                printf("\n");
+                fflush(stdout);
+            }
+        }
+    }
+
+    printf("\n%lu reports, %lu dropped, %lu CRC errors, %lu framing errors\n",
+           decoder.reports, decoder.dropped, decoder.crc_errors,
+           decoder.frame_errors);
+
+    close(fd);
+    return 0;
+}
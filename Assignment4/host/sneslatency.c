@@ -0,0 +1,271 @@
+// A program that measures how long it takes for a change to the SNES
+// controller's buttons to reach the host. The firmware must be built using
+// 'make LATENCY=1' (see latency.c), with GPIO 17 wired to the DATA input in
+// place of the controller. The program opens a serial port (default
+// /dev/ttyUSB1 at 115200 Baud), timestamps the arrival of each text report,
+// and pairs it with the "L" record line that follows it, which holds the
+// firmware's own timestamps. When the program is interrupted with Ctrl-C, or
+// after -n records, it prints the 50th and 99th percentiles and the maximum of
+// each part of the latency:
+//
+//   poll       from the edge until the sample that saw it was latched
+//   acquire    from the latch until the main loop had the sample
+//   serialize  from then until the report was in the UART's ring buffer
+//   uart       from then until the last byte was in the transmit FIFO
+//   host       the time on the wire, plus the host's own delay
+//   total      from the edge until the report arrived
+//
+// The Pi's and the host's clocks are not synchronized, so the host's delay is
+// taken to be the amount by which (arrival - written) exceeds its minimum over
+// nearby records. The host's fixed delay cannot be seen this way, so it is
+// left out, along with any fixed part of the USB adapter's delay.
+//
+// Usage:  sneslatency [-n count] [device [baud]]
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// The number of records on either side of a record that are used to find the
+// minimum of (arrival - written). This is short enough that the two clocks do
+// not drift far apart within it.
+#define WINDOW          32
+
+enum { POLL, ACQUIRE, SERIALIZE, UART, HOST, TOTAL, STAGES };
+
+static const char *stage_names[STAGES] = {
+    "poll", "acquire", "serialize", "uart", "host", "total"
+};
+
+// A single measurement. The firmware's times are unwrapped into 64 bits.
+struct record {
+    int64_t edge, latch, ready, enqueued, written;  // Pi, microseconds
+    int64_t arrival;                                // Host, microseconds
+    unsigned int bytes;                             // Length of the report
+};
+
+static volatile sig_atomic_t done;
+
+static void stop(int sig)
+{
+    (void)sig;
+    done = 1;
+}
+
+static speed_t baud_to_speed(long baud)
+{
+    switch (baud) {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+#ifdef B3000000
+    case 3000000: return B3000000;
+#endif
+    default:      return 0;
+    }
+}
+
+static int64_t host_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Extend a 32-bit firmware time to 64 bits, given the last extended time. The
+// firmware's times for one record are all within 2^31 us of each other.
+static int64_t unwrap(uint32_t t, int64_t last)
+{
+    return last + (int32_t)(t - (uint32_t)last);
+}
+
+static int compare(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void summarize(const struct record *rec, size_t count, long baud)
+{
+    int64_t *values[STAGES];
+    int64_t offset, d;
+    size_t i, j, lo, hi, p50, p99;
+    int s;
+
+    if (count == 0) {
+        printf("\nNo records\n");
+        return;
+    }
+
+    for (s = 0; s < STAGES; s++) {
+        values[s] = malloc(count * sizeof(int64_t));
+        if (values[s] == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        // Find the smallest (arrival - written) near this record
+        lo = i > WINDOW ? i - WINDOW : 0;
+        hi = i + WINDOW < count ? i + WINDOW : count - 1;
+        offset = rec[i].arrival - rec[i].written;
+        for (j = lo; j <= hi; j++) {
+            d = rec[j].arrival - rec[j].written;
+            if (d < offset) {
+                offset = d;
+            }
+        }
+
+        values[POLL][i] = rec[i].latch - rec[i].edge;
+        values[ACQUIRE][i] = rec[i].ready - rec[i].latch;
+        values[SERIALIZE][i] = rec[i].enqueued - rec[i].ready;
+        values[UART][i] = rec[i].written - rec[i].enqueued;
+
+        // 10 bits per byte on the wire, including the start and stop bits
+        values[HOST][i] = rec[i].arrival - rec[i].written - offset +
+                          (int64_t)rec[i].bytes * 10 * 1000000 / baud;
+        values[TOTAL][i] = rec[i].written - rec[i].edge + values[HOST][i];
+    }
+
+    p50 = (count - 1) * 50 / 100;
+    p99 = (count - 1) * 99 / 100;
+    printf("\n%zu records (microseconds)\n", count);
+    printf("%-10s %10s %10s %10s\n", "stage", "p50", "p99", "max");
+    for (s = 0; s < STAGES; s++) {
+        qsort(values[s], count, sizeof(int64_t), compare);
+        printf("%-10s %10lld %10lld %10lld\n", stage_names[s],
+               (long long)values[s][p50], (long long)values[s][p99],
+               (long long)values[s][count - 1]);
+        free(values[s]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device = "/dev/ttyUSB1";
+    long baud = 115200;
+    unsigned long limit = 0;
+    struct record *rec = NULL, *r;
+    size_t count = 0, capacity = 0;
+    struct termios tio;
+    char buf[256], line[128];
+    size_t length = 0;
+    unsigned int t[5], report_bytes = 0;
+    int64_t arrival, report_arrival = -1, last = 0, pi[5];
+    ssize_t n, i;
+    speed_t speed;
+    int fd, opt, k;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            limit = strtoul(optarg, NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [-n count] [device [baud]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        device = argv[optind++];
+    }
+    if (optind < argc) {
+        baud = atol(argv[optind]);
+    }
+
+    speed = baud_to_speed(baud);
+    if (speed == 0) {
+        fprintf(stderr, "Unsupported Baud rate: %ld\n", baud);
+        return 1;
+    }
+
+    fd = open(device, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(device);
+        return 1;
+    }
+
+    // Put the serial port into raw mode, so that bytes are passed on as soon
+    // as they arrive rather than a line at a time
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    signal(SIGINT, stop);
+
+    while (!done && (limit == 0 || count < limit) &&
+           (n = read(fd, buf, sizeof(buf))) > 0) {
+        arrival = host_now_us();
+
+        for (i = 0; i < n; i++) {
+            if (buf[i] != '\n') {
+                if (buf[i] != '\r' && length < sizeof(line) - 1) {
+                    line[length++] = buf[i];
+                }
+                continue;
+            }
+            line[length] = '\0';
+
+            if (strncmp(line, "0x", 2) == 0) {
+                // A report: the time its last byte arrived is the time
+                // it was received. Count the CR/LF pair too.
+                report_arrival = arrival;
+                report_bytes = length + 2;
+            } else if (line[0] == 'L' && report_arrival >= 0 &&
+                       sscanf(line, "L %x %x %x %x %x", &t[0], &t[1],
+                              &t[2], &t[3], &t[4]) == 5) {
+                // The record for the report that was just received
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 1024;
+                    rec = realloc(rec, capacity * sizeof(*rec));
+                    if (rec == NULL) {
+                        perror("realloc");
+                        return 1;
+                    }
+                }
+                r = &rec[count++];
+                if (count == 1) {
+                    last = t[0];
+                }
+                for (k = 0; k < 5; k++) {
+                    pi[k] = last = unwrap(t[k], last);
+                }
+                r->edge = pi[0];
+                r->latch = pi[1];
+                r->ready = pi[2];
+                r->enqueued = pi[3];
+                r->written = pi[4];
+                r->arrival = report_arrival;
+                r->bytes = report_bytes;
+                report_arrival = -1;
+                printf("\r%zu records", count);
+                fflush(stdout);
+            } else {
+                // Anything else (such as the start-up message) ends any
+                // pairing, since a record must follow its report directly
+                report_arrival = -1;
+            }
+            length = 0;
+        }
+    }
+
+    summarize(rec, count, baud);
+
+    free(rec);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// A decoder for the binary SNES reports sent by the firmware. See snesproto.h
+// for how to use it, and report.c in the parent directory for the encoder.
+
+#include <string.h>
+
+#include "snesproto.h"
+
+
+
+// Calculate the CRC-16/CCITT-FALSE of a block of bytes (polynomial 0x1021,
+// initial value 0xFFFF), exactly as the firmware does
+uint16_t snes_crc16(const uint8_t *data, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    int bit;
+
+    while (n--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000) {
+                crc = (uint16_t)((crc << 1) ^ 0x1021);
+            } else {
+                crc = (uint16_t)(crc << 1);
+            }
+        }
+    }
+
+    return crc;
+}
+
+
+
+// Decode a COBS-encoded block (without its delimiter). Returns the number of
+// decoded bytes, or -1 if the encoding is invalid or the result does not fit.
+static int cobs_decode(const uint8_t *in, size_t n, uint8_t *out,
+                       size_t out_size)
+{
+    size_t read_index = 0, write_index = 0;
+    uint8_t code, i;
+
+    while (read_index < n) {
+        code = in[read_index++];
+        if (code == 0 || read_index + code - 1 > n) {
+            return -1;
+        }
+
+        // Copy the run of non-zero bytes
+        for (i = 1; i < code; i++) {
+            if (write_index >= out_size) {
+                return -1;
+            }
+            out[write_index++] = in[read_index++];
+        }
+
+        // Each run except the last (and except a full 254-byte run) ended
+        // with a zero byte
+        if (code < 0xFF && read_index < n) {
+            if (write_index >= out_size) {
+                return -1;
+            }
+            out[write_index++] = 0;
+        }
+    }
+
+    return (int)write_index;
+}
+
+
+
+void snes_decoder_init(struct snes_decoder *d)
+{
+    memset(d, 0, sizeof(*d));
+}
+
+
+
+int snes_decoder_feed(struct snes_decoder *d, uint8_t byte,
+                      struct snes_report *report)
+{
+    uint8_t payload[SNES_PAYLOAD_SIZE];
+    int n;
+
+    // Collect bytes until the delimiter. A frame that is too long is
+    // remembered as bad, and discarded when its delimiter arrives.
+    if (byte != 0) {
+        if (d->length < sizeof(d->frame)) {
+            d->frame[d->length++] = byte;
+        } else {
+            d->overlong = 1;
+        }
+        return 0;
+    }
+
+    // An empty frame is just a delimiter used to resynchronize
+    if (d->length == 0 && !d->overlong) {
+        return 0;
+    }
+
+    n = d->overlong ? -1 : cobs_decode(d->frame, d->length, payload,
+                                       sizeof(payload));
+    d->length = 0;
+    d->overlong = 0;
+
+    if (n != SNES_PAYLOAD_SIZE) {
+        d->frame_errors++;
+        return 0;
+    }
+
+    if (snes_crc16(payload, SNES_PAYLOAD_SIZE - 2) !=
+        (uint16_t)(payload[7] | (payload[8] << 8))) {
+        d->crc_errors++;
+        return 0;
+    }
+
+    report->sequence = payload[0];
+    report->buttons = (uint16_t)(payload[1] | (payload[2] << 8));
+    report->timestamp_us = (uint32_t)payload[3] |
+                           ((uint32_t)payload[4] << 8) |
+                           ((uint32_t)payload[5] << 16) |
+                           ((uint32_t)payload[6] << 24);
+
+    // Any gap in the sequence numbers means reports were lost
+    report->dropped = d->have_sequence ?
+        (uint8_t)(report->sequence - d->last_sequence - 1) : 0;
+    d->dropped += report->dropped;
+    d->last_sequence = report->sequence;
+    d->have_sequence = 1;
+    d->reports++;
+
+    return 1;
+}
@@ -0,0 +1,49 @@
+// A decoder for the binary SNES reports sent by the firmware when it is built
+// using 'make REPORT=binary'. See report.c in the parent directory for a
+// description of the frame format.
+//
+// Bytes received from the serial port are passed one at a time to
+// snes_decoder_feed(), which returns 1 whenever a complete, valid report has
+// been decoded. Frames with a bad CRC or a bad length are discarded and
+// counted, and gaps in the sequence numbers are counted as dropped reports.
+
+#ifndef SNESPROTO_H
+#define SNESPROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The number of bytes in a decoded report, and the largest number of bytes
+// in an encoded frame (not counting the 0x00 delimiter)
+#define SNES_PAYLOAD_SIZE       9
+#define SNES_FRAME_MAX          (SNES_PAYLOAD_SIZE + 1)
+
+// A decoded report
+struct snes_report {
+    uint8_t  sequence;          // Sequence number (0 - 255)
+    uint16_t buttons;           // Button mask; a 1 bit is a pressed button
+    uint32_t timestamp_us;      // Firmware timestamp, in microseconds
+    unsigned dropped;           // Reports missing just before this one
+};
+
+// The state of a decoder, and counts of what it has seen
+struct snes_decoder {
+    uint8_t  frame[SNES_FRAME_MAX];
+    size_t   length;            // Bytes of the current frame received so far
+    int      overlong;          // The current frame is too long
+    int      have_sequence;     // last_sequence is valid
+    uint8_t  last_sequence;
+
+    unsigned long reports;      // Valid reports decoded
+    unsigned long crc_errors;   // Frames discarded because of a bad CRC
+    unsigned long frame_errors; // Frames discarded because of a bad length
+                                // or bad COBS encoding
+    unsigned long dropped;      // Reports missing from the sequence
+};
+
+void snes_decoder_init(struct snes_decoder *d);
+int snes_decoder_feed(struct snes_decoder *d, uint8_t byte,
+                      struct snes_report *report);
+uint16_t snes_crc16(const uint8_t *data, size_t n);
+
+#endif
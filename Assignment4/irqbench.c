@@ -0,0 +1,382 @@
+// The functions in this file measure how quickly the program responds to
+// interrupts, and how many it can handle each second, using interrupts that it
+// raises itself: a software generated interrupt (SGI) sent through GICD_SGIR,
+// and a shared peripheral interrupt (SPI) made pending through GICD_ISPENDR.
+// They are only compiled into the program when it is built using 'make
+// irqbench', which defines the IRQBENCH symbol, and also makes the IRQ stub
+// in startV2.s and IRQ_handler() note the time. Nothing here depends on the
+// board's peripherals other than the GIC, so it gives the same kind of
+// numbers under Qemu ('make irqbench run').
+//
+// All times are read from the ARM generic timer's counter (CNTPCT_EL0): when
+// the interrupt is triggered, when the IRQ vector is entered, when the C
+// handler starts, and when IRQ_handler() has signalled the end of the
+// interrupt. Each is measured IRQBENCH_SAMPLES times, and the results are
+// written to the console in hexadecimal, in nanoseconds since the trigger:
+//
+//   <source> vector:    <min>  <median>  <99th percentile>  <max>
+//   <source> handler:   <min>  <median>  <99th percentile>  <max>
+//   <source> EOI:       <min>  <median>  <99th percentile>  <max>
+//
+// followed by the number of interrupts handled per second, first when each
+// one is triggered after the last has returned (one per exception), and then
+// when each handler triggers the next, so that IRQ_handler() can take them
+// without leaving the exception (chained). The resolution is one counter
+// tick, which is about 18.5 ns on the Pi 4.
+
+#ifdef IRQBENCH
+
+// Header files
+#include "uart.h"
+#include "sysreg.h"
+#include "timebase.h"
+#include "systimer.h"
+#include "gic.h"
+#include "irqbench.h"
+
+// The number of times each latency is measured, and the number of interrupts
+// used to measure each rate
+#define IRQBENCH_SAMPLES        1000
+#define IRQBENCH_BURST          10000
+
+// The interrupts that are raised. The SPI is that of System Timer compare
+// channel C1, which systimer.c has not taken over yet, and which is kept from
+// matching while we use it.
+#define IRQBENCH_SGI_ID         2
+#define IRQBENCH_SPI_ID         GIC_SYSTIMER_C1_IRQ_ID
+
+// The value written to GICD_SGIR to send the SGI to the core that writes it
+#define IRQBENCH_SGI_TO_SELF    ((0x2 << 24) | IRQBENCH_SGI_ID)
+
+// Set by the IRQ stub in startV2.s and by IRQ_handler() (see irqbench.h)
+volatile unsigned long irq_vector_ticks;
+volatile unsigned long irq_eoi_ticks;
+
+// The time the handler last started, the number of times it has run, and the
+// number of interrupts it still has to trigger itself, using chain_trigger()
+static volatile unsigned long handler_ticks;
+static volatile unsigned int handler_count;
+static volatile unsigned int chain_left;
+static void (*chain_trigger)();
+
+// The measurements, in counter ticks since the trigger
+static unsigned int vector_samples[IRQBENCH_SAMPLES];
+static unsigned int handler_samples[IRQBENCH_SAMPLES];
+static unsigned int eoi_samples[IRQBENCH_SAMPLES];
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       send_sgi
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sends the SGI to this core.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void send_sgi()
+{
+    *GIC_GICD_SGIR = IRQBENCH_SGI_TO_SELF;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       pend_spi
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function makes the SPI pending. There is 1 bit per
+//                  interrupt. The GIC clears it again when the interrupt is
+//                  acknowledged.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void pend_spi()
+{
+    *(GIC_GICD_ISPENDR + (IRQBENCH_SPI_ID / 32)) =
+        (0x1 << (IRQBENCH_SPI_ID % 32));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       irqbench_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is the handler for both interrupts. It notes
+//                  the time, counts the interrupt, and triggers the next one
+//                  if it is measuring a chained rate.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void irqbench_handler()
+{
+    handler_ticks = timebase_ticks();
+    handler_count++;
+
+    if (chain_left != 0) {
+        chain_left--;
+        chain_trigger();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       sort_samples
+//
+//  Arguments:      samples:  The measurements to sort
+//
+//  Returns:        void
+//
+//  Description:    This function sorts IRQBENCH_SAMPLES measurements into
+//                  ascending order, using a Shell sort.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void sort_samples(unsigned int *samples)
+{
+    unsigned int gap, i, j, value;
+
+
+    for (gap = IRQBENCH_SAMPLES / 2; gap > 0; gap /= 2) {
+        for (i = gap; i < IRQBENCH_SAMPLES; i++) {
+            value = samples[i];
+            for (j = i; j >= gap && samples[j - gap] > value; j -= gap) {
+                samples[j] = samples[j - gap];
+            }
+            samples[j] = value;
+        }
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       print_samples
+//
+//  Arguments:      label:    The rest of the row's name, padded so that the
+//                            values line up
+//                  samples:  The measurements
+//
+//  Returns:        void
+//
+//  Description:    This function sorts the measurements, and prints out one
+//                  row of the latency table: the minimum, median, 99th
+//                  percentile, and maximum, in nanoseconds.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_samples(char *label, unsigned int *samples)
+{
+    sort_samples(samples);
+
+    uart_puts(label);
+    uart_puts("0x");
+    uart_puthex(ticks_to_ns(samples[0]));
+    uart_puts("  0x");
+    uart_puthex(ticks_to_ns(samples[IRQBENCH_SAMPLES / 2]));
+    uart_puts("  0x");
+    uart_puthex(ticks_to_ns(samples[IRQBENCH_SAMPLES * 99 / 100]));
+    uart_puts("  0x");
+    uart_puthex(ticks_to_ns(samples[IRQBENCH_SAMPLES - 1]));
+    uart_puts("\n");
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       measure_latency
+//
+//  Arguments:      name:     The name of the interrupt (3 characters)
+//                  trigger:  The function that triggers it
+//
+//  Returns:        void
+//
+//  Description:    This function triggers the interrupt IRQBENCH_SAMPLES
+//                  times, waiting each time until IRQ_handler() has signalled
+//                  the end of it. It then prints out the times it took to
+//                  reach the IRQ vector, the handler, and the end of the
+//                  interrupt. IRQs must be enabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void measure_latency(char *name, void (*trigger)())
+{
+    unsigned long start;
+    int i;
+
+
+    for (i = 0; i < IRQBENCH_SAMPLES; i++) {
+        irq_eoi_ticks = 0;
+
+        // Trigger the interrupt, and wait until it has been dealt with
+        start = timebase_ticks();
+        trigger();
+        while (irq_eoi_ticks == 0)
+            ;
+
+        vector_samples[i] = irq_vector_ticks - start;
+        handler_samples[i] = handler_ticks - start;
+        eoi_samples[i] = irq_eoi_ticks - start;
+    }
+
+    uart_puts("  ");
+    uart_puts(name);
+    print_samples(" vector:         ", vector_samples);
+    uart_puts("  ");
+    uart_puts(name);
+    print_samples(" handler:        ", handler_samples);
+    uart_puts("  ");
+    uart_puts(name);
+    print_samples(" EOI:            ", eoi_samples);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       measure_rate
+//
+//  Arguments:      trigger:  The function that triggers the interrupt
+//                  chained:  1 if each handler triggers the next interrupt, or
+//                            0 if each is triggered once the last has returned
+//
+//  Returns:        The number of interrupts handled per second
+//
+//  Description:    This function times IRQBENCH_BURST interrupts, triggered
+//                  one after another as fast as they are handled. IRQs must
+//                  be enabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long measure_rate(void (*trigger)(), int chained)
+{
+    unsigned long start, elapsed;
+    unsigned int count;
+    int i;
+
+
+    handler_count = 0;
+    start = timebase_ticks();
+
+    if (chained) {
+        // Let the handler trigger the rest
+        chain_trigger = trigger;
+        chain_left = IRQBENCH_BURST - 1;
+        trigger();
+        while (handler_count < IRQBENCH_BURST)
+            ;
+    } else {
+        for (i = 0; i < IRQBENCH_BURST; i++) {
+            count = handler_count;
+            trigger();
+            while (handler_count == count)
+                ;
+        }
+    }
+
+    elapsed = timebase_ticks() - start;
+
+    return IRQBENCH_BURST * timebase_frequency() / elapsed;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       measure_rates
+//
+//  Arguments:      name:     The name of the interrupt (3 characters)
+//                  trigger:  The function that triggers it
+//
+//  Returns:        void
+//
+//  Description:    This function measures and prints out the interrupt's
+//                  rates, one per exception and chained.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void measure_rates(char *name, void (*trigger)())
+{
+    unsigned long single, chained;
+
+
+    single = measure_rate(trigger, 0);
+    chained = measure_rate(trigger, 1);
+
+    uart_puts("  ");
+    uart_puts(name);
+    uart_puts(" one per exception:   0x");
+    uart_puthex(single);
+    uart_puts("\n  ");
+    uart_puts(name);
+    uart_puts(" chained:             0x");
+    uart_puthex(chained);
+    uart_puts("\n");
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       irqbench_run
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sets up the GIC and the two interrupts, and
+//                  then runs and prints out each measurement. The UART and
+//                  timebase must already be initialized, and the UART must
+//                  not yet be in interrupt-driven mode. IRQs are left
+//                  disabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void irqbench_run()
+{
+    // Keep System Timer channel C1 as far from matching as it can be, and
+    // clear any match left over from before we started, so that only
+    // pend_spi() raises its interrupt
+    *SYSTEM_TIMER_C1 = *SYSTEM_TIMER_CLO - 1;
+    *SYSTEM_TIMER_CS = SYSTEM_TIMER_CS_M1;
+
+    // Set up the GIC, and the handler for both interrupts
+    gic_init();
+    irq_register(IRQBENCH_SGI_ID, irqbench_handler, GIC_DEFAULT_PRIORITY,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_EDGE);
+    irq_register(IRQBENCH_SPI_ID, irqbench_handler, GIC_DEFAULT_PRIORITY,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+    enableIRQ();
+
+    uart_puts("\nInterrupt latency (ns since the trigger):\n");
+    uart_puts("                      "
+              "min         median      p99         max\n");
+    measure_latency("SGI", send_sgi);
+    measure_latency("SPI", pend_spi);
+
+    uart_puts("\nInterrupts per second:\n");
+    measure_rates("SGI", send_sgi);
+    measure_rates("SPI", pend_spi);
+    uart_puts("\n");
+
+    disableIRQ();
+}
+
+#endif
@@ -0,0 +1,16 @@
+// These are the function prototypes for the interrupt benchmarks that are
+// built into the program when it is compiled using 'make irqbench' (see
+// irqbench.c)
+
+#ifndef IRQBENCH_H
+#define IRQBENCH_H
+
+// The generic timer's count when the IRQ vector was last entered, and when
+// IRQ_handler() last signalled the end of an interrupt. They are set by the
+// IRQ stub in startV2.s and by IRQ_handler() in irqbench builds only.
+extern volatile unsigned long irq_vector_ticks;
+extern volatile unsigned long irq_eoi_ticks;
+
+void irqbench_run();
+
+#endif
@@ -0,0 +1,325 @@
+// The functions in this file measure how long it takes for a change to the
+// SNES controller's buttons to reach the host. They are only compiled into the
+// program when it is built using 'make LATENCY=1', which defines the LATENCY
+// symbol, and they only work with the text report (REPORT=text).
+//
+// Instead of a controller, a jumper wire connects the stimulus pin (GPIO 17)
+// to the DATA input. Every bit then reads the same, so driving the pin low
+// looks like every button being pressed (0xFFFF), and driving it high like
+// none (0x0000). A software timer toggles the pin at random times, between 2
+// and 5 polling periods apart, so that the edges land at every point in the
+// polling cycle.
+//
+// For each edge, the following times are recorded (see now_us()):
+//
+//   edge       when the stimulus pin was toggled
+//   latch      when the sample that first saw the change was latched
+//   ready      when the main loop got the completed sample
+//   enqueued   when the report had been put into the UART's ring buffer
+//   written    when the last byte of the report was written into the UART's
+//              transmit FIFO (see uart_tx_drained())
+//
+// After the report line, a line of the form
+//
+//   L <edge> <latch> <ready> <enqueued> <written>
+//
+// is sent, with each time as 8 hexadecimal digits (the low 32 bits). The
+// sneslatency host tool (in host/) timestamps the arrival of each report, and
+// uses these lines to break the total latency down into its parts.
+
+#ifdef LATENCY
+
+// Header files
+#include "gpio.h"
+#include "latency.h"
+#include "swtimer.h"
+#include "sysreg.h"
+#include "timebase.h"
+#include "uart.h"
+
+// The stimulus pin
+#define STIMULUS_PIN            17
+
+// States of a measurement
+#define LATENCY_IDLE            0       // Waiting for a sample to see the edge
+#define LATENCY_QUEUEING        1       // Report being put in the ring buffer
+#define LATENCY_SENDING         2       // Waiting for the report to be written
+#define LATENCY_WRITTEN         3       // Waiting to send the record
+#define LATENCY_DONE            4       // Record sent for the latest edge
+
+// The timer that toggles the stimulus pin, and the pin's level
+static struct swtimer stimulus_timer;
+static unsigned int stimulus_level = 1;
+static unsigned int poll_period;
+static unsigned int random_state = 1;
+
+// The measurement in progress. The state and times written by interrupt
+// handlers are volatile.
+static volatile int state = LATENCY_DONE;
+static volatile unsigned long edge_time;
+static volatile unsigned short expected;
+static unsigned long latch_time, ready_time, enqueued_time;
+static volatile unsigned long written_time;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       next_random
+//
+//  Arguments:      none
+//
+//  Returns:        A pseudo-random number from 0 to 65535
+//
+//  Description:    This function is a simple linear congruential generator.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned int next_random()
+{
+    random_state = random_state * 1103515245 + 12345;
+
+    return (random_state >> 16) & 0xFFFF;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       stimulus_edge
+//
+//  Arguments:      timer:   The stimulus timer
+//                  arg:     Not used
+//
+//  Returns:        void
+//
+//  Description:    This timer callback toggles the stimulus pin, records the
+//                  time, and sets the timer for the next edge.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void stimulus_edge(struct swtimer *timer, void *arg)
+{
+    stimulus_level ^= 1;
+    if (stimulus_level) {
+        gpio_set(STIMULUS_PIN);
+    } else {
+        gpio_clear(STIMULUS_PIN);
+    }
+
+    // A low DATA line reads as a pressed button
+    edge_time = now_us();
+    expected = stimulus_level ? 0x0000 : 0xFFFF;
+    state = LATENCY_IDLE;
+
+    swtimer_start(timer, 2 * poll_period +
+                  (next_random() * 3 * poll_period) / 65536, 0);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       latency_init
+//
+//  Arguments:      period:  The polling period, in microseconds
+//
+//  Returns:        void
+//
+//  Description:    This function sets up the stimulus pin as an output, high,
+//                  and starts the stimulus timer. swtimer_init() must be
+//                  called first.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void latency_init(unsigned int period)
+{
+    static const struct gpio_pin_config pins[] = {
+        { STIMULUS_PIN, GPIO_FUNCTION_OUTPUT, GPIO_PULL_NONE }
+    };
+
+
+    poll_period = period;
+
+    // Set the pin high, and then make it an output
+    gpio_set(STIMULUS_PIN);
+    gpio_configure(pins, 1);
+
+    swtimer_setup(&stimulus_timer, stimulus_edge, 0);
+    swtimer_start(&stimulus_timer, 2 * poll_period, 0);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       latency_sampled
+//
+//  Arguments:      sample:  A sample whose buttons differ from the last one
+//                  ready:   When the main loop got the sample
+//
+//  Returns:        void
+//
+//  Description:    This function is called before a report is sent. If the
+//                  sample is the first to show the latest edge, it records the
+//                  times. Samples that were latched before the edge, or while
+//                  the pin was changing part way through a reading, are
+//                  ignored. The stimulus timer can preempt us and start a new
+//                  measurement, so IRQs are masked while we look at the state.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void latency_sampled(const struct snes_sample *sample, unsigned long ready)
+{
+    unsigned int irq_masked;
+
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (state == LATENCY_IDLE && sample->buttons == expected &&
+        sample->timestamp >= edge_time) {
+        latch_time = sample->timestamp;
+        ready_time = ready;
+        state = LATENCY_QUEUEING;
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       latency_enqueued
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called once a report has been handed to
+//                  the UART. The UART may have drained its ring buffer part
+//                  way through the report, so its drained notices are ignored
+//                  until now. If the whole report has already gone into the
+//                  transmit FIFO, it was written when it was enqueued;
+//                  otherwise uart_tx_drained() records the time later.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void latency_enqueued()
+{
+    unsigned int irq_masked;
+
+
+    // Stop the UART's interrupt handler from running while we look at the
+    // ring buffer
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (state == LATENCY_QUEUEING) {
+        enqueued_time = now_us();
+        if (uart_tx_empty()) {
+            written_time = enqueued_time;
+            state = LATENCY_WRITTEN;
+        } else {
+            state = LATENCY_SENDING;
+        }
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_tx_drained
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function replaces the default one in the UART driver.
+//                  It records when the last byte of the report was written
+//                  into the transmit FIFO. The UART's handler can be
+//                  preempted by the stimulus timer, which also changes the
+//                  state, so IRQs are masked while we do.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_tx_drained()
+{
+    unsigned int irq_masked;
+
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (state == LATENCY_SENDING) {
+        written_time = now_us();
+        state = LATENCY_WRITTEN;
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       latency_report
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sends the record of a completed measurement,
+//                  if there is one. The stimulus timer can preempt us and
+//                  start a new measurement, so IRQs are masked while we claim
+//                  the record, and the edge time is copied before it can
+//                  change.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void latency_report()
+{
+    unsigned long edge;
+    unsigned int irq_masked;
+
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (state != LATENCY_WRITTEN) {
+        if (!irq_masked) {
+            enableIRQ();
+        }
+        return;
+    }
+    state = LATENCY_DONE;
+    edge = edge_time;
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+
+    uart_puts("L ");
+    uart_puthex((unsigned int)edge);
+    uart_puts(" ");
+    uart_puthex((unsigned int)latch_time);
+    uart_puts(" ");
+    uart_puthex((unsigned int)ready_time);
+    uart_puts(" ");
+    uart_puthex((unsigned int)enqueued_time);
+    uart_puts(" ");
+    uart_puthex((unsigned int)written_time);
+    uart_puts("\n");
+}
+
+#endif
@@ -0,0 +1,14 @@
+// These are the function prototypes for the latency measurement harness (see
+// latency.c)
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "snes.h"
+
+void latency_init(unsigned int period);
+void latency_sampled(const struct snes_sample *sample, unsigned long ready);
+void latency_enqueued();
+void latency_report();
+
+#endif
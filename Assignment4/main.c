@@ -2,271 +2,164 @@
 
 // Include files
 #include "uart.h"
-#include "gpio.h"
 #include "systimer.h"
+#include "timebase.h"
+#include "swtimer.h"
+#include "bench.h"
+#include "irqbench.h"
+#include "gic.h"
+#include "sysreg.h"
+#include "report.h"
+#include "cyclic.h"
+#include "snes.h"
+#include "events.h"
+#include "latency.h"
+
+// The number of times per second to read the SNES controller. This is set by
+// the Makefile (e.g. 'make POLL_HZ=1000').
+#ifndef POLL_HZ
+#define POLL_HZ         30
+#endif
+#if POLL_HZ < 1 || POLL_HZ > 1000
+#error "POLL_HZ must be from 1 to 1000"
+#endif
+
+// The latency harness (see latency.c) only understands text reports
+#if defined(LATENCY) && (defined(REPORT_BINARY) || defined(REPORT_EVENTS))
+#error "LATENCY can only be used with REPORT=text"
+#endif
 
-// Function prototypes
-unsigned short get_SNES();
-void init_GPIO9_to_output();
-void set_GPIO9();
-void clear_GPIO9();
-void init_GPIO11_to_output();
-void set_GPIO11();
-void clear_GPIO11();
-void init_GPIO10_to_input();
-unsigned int get_GPIO10();
 
 
 
 void main()
 {
-    unsigned short data, currentState = 0xFFFF;
+    struct snes_sample sample;
+    struct cyclic schedule;
+#ifdef REPORT_EVENTS
+    struct snes_event events[EVENTS_MAX];
+    int i, count;
+#else
+    unsigned short currentState = 0xFFFF;
+#endif
+#ifdef LATENCY
+    unsigned long ready;
+#endif
 	
 
+    // Set up the ARM generic timer timebase, which is used for all delays
+    timebase_init();
+
     // Set up the UART serial port
     uart_init();
     
-    // Set up GPIO pin 9 for output (LATCH output)
-    init_GPIO9_to_output();
-    
-    // Set up GPIO pin 11 for output (CLOCK output)
-    init_GPIO11_to_output();
-    
-    // Set up GPIO pin 10 for input (DATA input)
-    init_GPIO10_to_input();
-    
-    // Clear the LATCH line (GPIO 9) to low
-    clear_GPIO9();
-    
-    // Set CLOCK line (GPIO 11) to high
-    set_GPIO11();
-    
-       
+#ifdef BENCHMARK
+    // Measure the program with the caches off and on (see bench.c)
+    bench_run();
+#endif
+#ifdef IRQBENCH
+    // Measure interrupt latency and throughput (see irqbench.c)
+    irqbench_run();
+#endif
+
+    // Set up the interrupt controller, and switch the UART over to being
+    // interrupt-driven so that writing out a report does not hold up the
+    // polling loop
+    gic_init();
+    uart_enable_interrupts();
+
+    // Let delays sleep until a timer interrupt, rather than polling
+    timebase_enable_interrupts();
+    systimer_init();
+
+    // Start the software timer service, which runs timer callbacks from the
+    // System Timer C3 interrupt
+    swtimer_init();
+    enableIRQ();
+
+    // Set up the GPIO pins used by the SNES controller
+    snes_init();
+
     // Print out a message to the console
     uart_puts("SNES Controller Program starting.\n");
+
+#ifdef REPORT_BINARY
+    // Reports are sent as binary frames, so mark the end of the text
+    report_init();
+#endif
+#ifdef REPORT_EVENTS
+    // Reports are sent as press, release, repeat, and chord events
+    events_init();
+#endif
+#ifdef LATENCY
+    // Toggle the stimulus pin at random times, to measure the latency from
+    // a change in the buttons to the host
+    latency_init(1000000 / POLL_HZ);
+#endif
     
-    // Loop forever, reading from the SNES controller 30 times per second
+    // Loop forever, reading from the SNES controller POLL_HZ times per second.
+    // Each read is released at a fixed time (see cyclic.c), so the rate does
+    // not drift however long it takes to read the controller and send the
+    // report.
+    cyclic_init(&schedule, POLL_HZ);
     while (1) {
-    	// Read data from the SNES controller
-		data = get_SNES();
-
+    	// Sleep until it is time for the next read
+    	cyclic_wait(&schedule);
+
+    	// Start reading the SNES controller in the background, and sleep
+    	// until the reading is complete
+		snes_start();
+		snes_wait_sample(&sample);
+#ifdef LATENCY
+		ready = now_us();
+#endif
+
+#ifdef REPORT_EVENTS
+		// Turn the sample into events, and write them out. This is done for
+		// every sample, since auto-repeats and chords depend on time as well
+		// as on changes to the buttons.
+		count = events_update(sample.buttons, sample.timestamp, events);
+		for (i = 0; i < count; i++) {
+			events_write(&events[i]);
+		}
+#else
 		// Write out data if the state of the controller has changed
-		if (data != currentState) {
+		if (sample.buttons != currentState) {
+#ifdef REPORT_BINARY
+			// Send a binary report, timestamped with the low 32 bits of the
+			// time the buttons were latched, in microseconds (see report.c)
+			report_send(sample.buttons, (unsigned int)sample.timestamp);
+#else
+#ifdef LATENCY
+			// Record the times, if this sample is the first to see the
+			// latest stimulus edge
+			latency_sampled(&sample, ready);
+#endif
+
 			// Write the data out to the console in hexadecimal
 			uart_puts("0x");
-			uart_puthex(data);
+			uart_puthex(sample.buttons);
 			uart_puts("\n");
+#ifdef LATENCY
+			latency_enqueued();
+#endif
+#endif
 
 			// Record the state of the controller
-			currentState = data;
+			currentState = sample.buttons;
 		}
-    	
-		// Delay 1/30th of a second
-		microsecond_delay(33333);
-    }
-}
+#endif
 
+#ifdef LATENCY
+		// Send the record of the last measurement, once its report has been
+		// written out
+		latency_report();
+#endif
 
-unsigned short get_SNES()
-{
-    int i;
-    unsigned short data = 0;
-    unsigned int value;
-	
-	
-    // Set LATCH to high for 12 microseconds. This causes the controller to
-    // latch the values of button presses into its internal register. The first
-    // serial bit also becomes available on the DATA line.
-    set_GPIO9();
-    microsecond_delay(12);
-    clear_GPIO9();
-	
-    // Output 16 clock pulses, and read 16 bits of serial data
-	for (i = 0; i < 16; i++) {
-		// Delay 6 microseconds (half a cycle)
-		microsecond_delay(6);
-		
-		// Clear the CLOCK line (creates a falling edge)
-		clear_GPIO11();
-		
-		// Read the value on the input DATA line
-		value = get_GPIO10();
-		
-		// Store the bit read. Note we convert a 0 (which indicates a button
-		// press) to a 1 in the returned 16-bit integer. Unpressed buttons will
-		// be encoded as a 0.
-		if (value == 0) {
-	    	data |= (0x1 << i);
+		// Write out the timing statistics if 's' is typed on the console
+		if (uart_rx_ready() && uart_getc() == 's') {
+			cyclic_dump(&schedule);
 		}
-		
-		// Delay 6 microseconds (half a cycle)
-		microsecond_delay(6);
-		
-		// Set the CLOCK to 1 (creates a rising edge). This causes the
-		// controller to output the next bit, which we read half a cycle later.
-		set_GPIO11();
     }
-	
-    // Return the encoded data
-    return data;
-}
-
-
-void init_GPIO9_to_output()
-{
-    register unsigned int r;
-    
-    
-    // Get the current contents of the GPIO Function Select Register 0
-    r = *GPFSEL0;
-
-    // Clear bits 27 - 29. This is the field FSEL9, which maps to GPIO pin 9.
-    // We clear the bits by ANDing with a 000 bit pattern in the field.
-    r &= ~(0x7 << 27);
-
-    // Set the field FSEL9 to 001, which sets pin 9 to an output pin. We do so
-    // by ORing the bit pattern 001 into the field.
-    r |= (0x1 << 27);
-
-    // Write the modified bit pattern back to the GPIO Function Select
-    // Register 0
-    *GPFSEL0 = r;
-
-
-    // Disable the pull-up/pull-down control line for GPIO pin 9:
-
-    // Get the current bit pattern of the GPPUPPDN0 register
-    r = *GPPUPPDN0;
-
-    // Zero out bits 18-19 in this bit pattern, since this maps to GPIO pin 9.
-    // The bit pattern 00 disables pullups/pulldowns.
-    r &= ~(0x3 << 18);
-
-    // Write the modified bit pattern back to the GPPUPPDN0 register
-    *GPPUPPDN0 = r;
 }
 
-
-void set_GPIO9()
-{
-    register unsigned int r;
-	  
-    // Put a 1 into the SET9 field of the GPIO Pin Output Set Register 0
-    r = (0x1 << 9);
-    *GPSET0 = r;
-}
-
-
-
-void clear_GPIO9()
-{
-    register unsigned int r;
-	  
-    // Put a 1 into the CLR9 field of the GPIO Pin Output Clear Register 0
-    r = (0x1 << 9);
-    *GPCLR0 = r;
-}
-
-
-
-void init_GPIO11_to_output()
-{
-    register unsigned int r;
-    
-    
-    // Get the current contents of the GPIO Function Select Register 1
-    r = *GPFSEL1;
-
-    // Clear bits 3 - 5. This is the field FSEL11, which maps to GPIO pin 11.
-    // We clear the bits by ANDing with a 000 bit pattern in the field.
-    r &= ~(0x7 << 3);
-
-    // Set the field FSEL11 to 001, which sets pin 9 to an output pin. We do so
-    // by ORing the bit pattern 001 into the field.
-    r |= (0x1 << 3);
-
-    // Write the modified bit pattern back to the GPIO Function Select
-    // Register 1
-    *GPFSEL1 = r;
-
-    
-    // Disable the pull-up/pull-down control line for GPIO pin 11:
-
-    // Get the current bit pattern of the GPPUPPDN0 register
-    r = *GPPUPPDN0;
-
-    // Zero out bits 22-23 in this bit pattern, since this maps to GPIO pin 11.
-    // The bit pattern 00 disables pullups/pulldowns.
-    r &= ~(0x3 << 22);
-
-    // Write the modified bit pattern back to the GPPUPPDN0 register
-    *GPPUPPDN0 = r;
-}
-
-
-
-void set_GPIO11()
-{
-    register unsigned int r;
-	  
-    // Put a 1 into the SET11 field of the GPIO Pin Output Set Register 0
-    r = (0x1 << 11);
-    *GPSET0 = r;
-}
-
-
-void clear_GPIO11()
-{
-    register unsigned int r;
-	  
-    // Put a 1 into the CLR11 field of the GPIO Pin Output Clear Register 0
-    r = (0x1 << 11);
-    *GPCLR0 = r;
-}
-
-
-
-void init_GPIO10_to_input()
-{
-    register unsigned int r;
-    
-    
-    // Get the current contents of the GPIO Function Select Register 1
-    r = *GPFSEL1;
-
-    // Clear bits 0 - 2. This is the field FSEL10, which maps to GPIO pin 10.
-    // We clear the bits by ANDing with a 000 bit pattern in the field. This
-    // sets the pin to be an input pin.
-    r &= ~(0x7 << 0);
-
-    // Write the modified bit pattern back to the GPIO Function Select
-    // Register 1
-    *GPFSEL1 = r;
-
-
-    // Disable the pull-up/pull-down control line for GPIO pin 10:
-
-    // Get the current bit pattern of the GPPUPPDN0 register
-    r = *GPPUPPDN0;
-
-    // Zero out bits 20-21 in this bit pattern, since this maps to GPIO pin 10.
-    // The bit pattern 00 disables pullups/pulldowns.
-    r &= ~(0x3 << 20);
-
-    // Write the modified bit pattern back to the GPPUPPDN0 register
-    *GPPUPPDN0 = r;
-}
-
-
-
-unsigned int get_GPIO10()
-{
-    register unsigned int r;
-	  
-	  
-    // Get the current contents of the GPIO Pin Level Register 0
-    r = *GPLEV0;
-	  
-    // Isolate pin 10, and return its value (a 0 if low, or a 1 if high)
-    return ((r >> 10) & 0x1);
-}
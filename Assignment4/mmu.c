@@ -0,0 +1,157 @@
+// The functions in this file build a set of translation tables that identity
+// map the first 4 GB of the physical address space, and then turn on the MMU
+// together with the instruction and data caches. Until this is done, every
+// load and store (including instruction fetches) goes directly to DRAM, since
+// the ARM architecture treats all memory as Device memory when the MMU is off.
+//
+// The memory map of the BCM2711 in the first 4 GB is:
+//
+//   0x00000000 - 0xFBFFFFFF   SDRAM (the amount actually fitted varies)
+//   0xFC000000 - 0xFFFFFFFF   Peripherals, including the main MMIO window at
+//                             0xFE000000 (MMIO_BASE) and the GIC-400 at
+//                             0xFF841000
+//
+// We use a 4 KB translation granule and a 32-bit virtual address space, so
+// the translation table walk starts at level 1. Each of the 4 level 1 entries
+// covers 1 GB and points to a level 2 table, whose 512 entries each map a
+// 2 MB block. RAM is mapped as Normal, inner and outer write-back cacheable
+// memory, and the peripheral area is mapped as Device-nGnRE memory which is
+// never cached and never executed from.
+
+// Header files
+#include "mmu.h"
+#include "sysreg.h"
+
+// The Memory Attribute Indirection Register (MAIR) holds 8 memory attribute
+// encodings. Block descriptors select one of these using their AttrIndx field.
+#define MAIR_DEVICE_nGnRE       0x04    // Device, non-gathering, non-reordering
+#define MAIR_NORMAL_WB          0xFF    // Normal, write-back, read/write-alloc
+#define MT_DEVICE_nGnRE         0       // AttrIndx values
+#define MT_NORMAL               1
+#define MAIR_VALUE              ((MAIR_DEVICE_nGnRE << (8 * MT_DEVICE_nGnRE)) | \
+                                 (MAIR_NORMAL_WB << (8 * MT_NORMAL)))
+
+// Translation Control Register (given in its EL1 form; see enableMMU)
+#define TCR_T0SZ                (32UL << 0)   // 32-bit virtual address space
+#define TCR_IRGN0_WBWA          (1UL << 8)    // Table walks are inner WB
+#define TCR_ORGN0_WBWA          (1UL << 10)   // Table walks are outer WB
+#define TCR_SH0_INNER           (3UL << 12)   // Inner shareable
+#define TCR_TG0_4K              (0UL << 14)   // 4 KB granule
+#define TCR_EPD1                (1UL << 23)   // No walks using TTBR1
+#define TCR_VALUE               (TCR_T0SZ | TCR_IRGN0_WBWA | TCR_ORGN0_WBWA | \
+                                 TCR_SH0_INNER | TCR_TG0_4K | TCR_EPD1)
+
+// Translation table descriptor fields
+#define PT_TABLE                0x3           // Level 1 entry -> next table
+#define PT_BLOCK                0x1           // Level 2 entry -> 2 MB block
+#define PT_ATTR(index)          ((unsigned long)(index) << 2)
+#define PT_INNER_SHAREABLE      (3UL << 8)
+#define PT_AF                   (1UL << 10)   // Access flag
+#define PT_PXN                  (1UL << 53)   // Privileged execute-never
+#define PT_UXN                  (1UL << 54)   // Unprivileged execute-never
+
+#define PT_NORMAL_BLOCK         (PT_BLOCK | PT_ATTR(MT_NORMAL) | \
+                                 PT_INNER_SHAREABLE | PT_AF)
+#define PT_DEVICE_BLOCK         (PT_BLOCK | PT_ATTR(MT_DEVICE_nGnRE) | \
+                                 PT_AF | PT_PXN | PT_UXN)
+
+// Layout of the mapped address space
+#define BLOCK_SIZE              0x200000UL    // 2 MB
+#define ENTRIES_PER_TABLE       512
+#define LEVEL1_ENTRIES          4             // 4 x 1 GB
+#define DEVICE_START            0xFC000000UL  // Start of the peripheral area
+
+
+// The translation tables. These are in the .bss section, so they have already
+// been zeroed out by the startup code. Each table must be aligned to a 4 KB
+// boundary.
+static unsigned long level1_table[LEVEL1_ENTRIES]
+    __attribute__((aligned(4096)));
+static unsigned long level2_tables[LEVEL1_ENTRIES][ENTRIES_PER_TABLE]
+    __attribute__((aligned(4096)));
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       mmu_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function fills in the translation tables so that RAM
+//                  is identity mapped as cacheable Normal memory using 2 MB
+//                  blocks, and the peripheral area (which includes MMIO_BASE
+//                  and the GIC) is identity mapped as Device-nGnRE memory.
+//                  It then turns on the MMU and caches for CPU Core 0. It is
+//                  called from the startup code just before main(), while the
+//                  other cores are still waiting to be released.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void mmu_init()
+{
+    unsigned long address;
+    int i, j;
+    
+
+    // Point each level 1 entry at its level 2 table
+    for (i = 0; i < LEVEL1_ENTRIES; i++) {
+        level1_table[i] = (unsigned long)level2_tables[i] | PT_TABLE;
+    }
+
+    // Fill in each level 2 table with 2 MB block entries. Anything below the
+    // start of the peripheral area is RAM.
+    for (i = 0; i < LEVEL1_ENTRIES; i++) {
+        for (j = 0; j < ENTRIES_PER_TABLE; j++) {
+            address = ((unsigned long)i * ENTRIES_PER_TABLE + j) * BLOCK_SIZE;
+            
+            if (address < DEVICE_START) {
+                level2_tables[i][j] = address | PT_NORMAL_BLOCK;
+            } else {
+                level2_tables[i][j] = address | PT_DEVICE_BLOCK;
+            }
+        }
+    }
+
+    // Throw away anything left in the data caches from before we were booted.
+    // This includes the shared L2 cache, which is safe since the other cores
+    // have not been released yet.
+    invalidateDCache();
+
+#ifdef BENCHMARK
+    // The benchmark measures the program with the caches off first, and turns
+    // them on itself afterwards using mmu_enable()
+    return;
+#endif
+
+    mmu_enable();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       mmu_enable
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function turns on the MMU, the data cache, and the
+//                  instruction cache on the calling CPU core, using the
+//                  translation tables built by mmu_init(). Any stale contents
+//                  of the core's own L1 data cache are invalidated first (the
+//                  shared L2 cache may already be in use by other cores).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void mmu_enable()
+{
+    // Throw away anything left in this core's data cache
+    invalidateLocalDCache();
+    
+    // Load the translation registers and turn on the MMU and caches
+    enableMMU((unsigned long)level1_table, TCR_VALUE, MAIR_VALUE);
+}
@@ -0,0 +1,4 @@
+// These are the function prototypes for setting up the MMU and caches
+
+void mmu_init();
+void mmu_enable();
@@ -0,0 +1,208 @@
+// The functions in this file read several SNES controllers at once. All the
+// controllers share the LATCH (GPIO 9) and CLOCK (GPIO 11) lines, so they all
+// shift out their bits together, and each one has its own DATA pin.
+//
+// Rather than reading each DATA pin separately, we read the GPIO Pin Level
+// Register 0 (GPLEV0) once per clock pulse, which samples all the bank 0 pins
+// at the same time. This gives a 16 x 32 matrix of bits, with one row for each
+// clock pulse and one column for each pin. Transposing the matrix turns each
+// column into a 16-bit word holding all the bits from one pin, which is that
+// controller's button state. So reading four or five controllers takes the
+// same 16 GPLEV0 reads as reading one.
+//
+// A multitap needs a second pass of 16 clock pulses with its select line low
+// (see snes.h), which gives a second matrix.
+//
+// These functions bit-bang the CLOCK line, so they are left out when SPI0
+// drives it instead (when SNES_SPI is defined).
+
+#ifndef SNES_SPI
+
+// Header files
+#include "gpio.h"
+#include "snes.h"
+#include "timebase.h"
+
+// Timing of the controller signals, in microseconds (as in snes.c)
+#define SNES_LATCH_TIME         12
+#define SNES_HALF_CYCLE         6
+#define SNES_BITS               16
+
+// The shared LATCH and CLOCK pins (as in snes.c)
+#define SNES_LATCH_PIN          9
+#define SNES_CLOCK_PIN          11
+
+// Four controllers with their DATA lines on GPIO 10, 22, 23, and 24
+const struct snes_wiring snes_wiring_parallel = {
+    4,
+    { 10, 22, 23, 24 },
+    { 0, 0, 0, 0 },
+    SNES_NO_PIN
+};
+
+// A controller with its DATA line on GPIO 10, plus a multitap with D0 on
+// GPIO 22, D1 on GPIO 23, and its select line on GPIO 24
+const struct snes_wiring snes_wiring_multitap = {
+    5,
+    { 10, 22, 23, 22, 23 },
+    { 0, 0, 0, 1, 1 },
+    24
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       transpose16
+//
+//  Arguments:      a:       A 16 x 16 matrix of bits, one row per element
+//
+//  Returns:        void
+//
+//  Description:    This function transposes a bit matrix in place, so that
+//                  bit i of a[j] and bit j of a[i] are exchanged. It does so in
+//                  four steps, swapping 8 x 8 blocks, then 4 x 4 blocks, then
+//                  2 x 2 blocks, then single bits, each step taking 8
+//                  exchanges of masked bits between pairs of rows. (See
+//                  "Hacker's Delight" by H. S. Warren, section 7-3.)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void transpose16(unsigned short a[16])
+{
+    unsigned int j, k;
+    unsigned short m, t;
+
+
+    m = 0x00FF;
+    for (j = 8; j != 0; j >>= 1, m ^= (m << j)) {
+        for (k = 0; k < 16; k = ((k | j) + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= (t << j);
+            a[k | j] ^= t;
+        }
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_pads_init
+//
+//  Arguments:      wiring:  How the controllers are wired up
+//
+//  Returns:        void
+//
+//  Description:    This function sets up the DATA pins (and the multitap
+//                  select pin) of the controllers. snes_init() must be called
+//                  first, to set up the LATCH and CLOCK pins. The DATA pins
+//                  are pulled up, so that a missing controller reads as no
+//                  buttons pressed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void snes_pads_init(const struct snes_wiring *wiring)
+{
+    struct gpio_pin_config pins[SNES_MAX_PADS + 1];
+    unsigned int i, count;
+
+
+    // Build a table of the pins, so that the registers they share are each
+    // written once
+    for (i = 0; i < wiring->pads; i++) {
+        pins[i].pin = wiring->data_pin[i];
+        pins[i].function = GPIO_FUNCTION_INPUT;
+        pins[i].pull = GPIO_PULL_UP;
+    }
+    count = wiring->pads;
+
+    // The select line is normally high, so set it before it becomes an output
+    if (wiring->select_pin != SNES_NO_PIN) {
+        gpio_set(wiring->select_pin);
+        pins[count].pin = wiring->select_pin;
+        pins[count].function = GPIO_FUNCTION_OUTPUT;
+        pins[count].pull = GPIO_PULL_NONE;
+        count++;
+    }
+
+    gpio_configure(pins, count);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_read_pads
+//
+//  Arguments:      wiring:  How the controllers are wired up
+//                  states:  An array with an element for each controller,
+//                           into which the button states are written
+//
+//  Returns:        void
+//
+//  Description:    This function reads all the controllers, using the same
+//                  latch pulse and clock timing as get_SNES(). As there, a 1
+//                  bit in a state means that the button is pressed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void snes_read_pads(const struct snes_wiring *wiring, unsigned short *states)
+{
+    unsigned int samples[2][SNES_BITS];
+    unsigned short low[2][SNES_BITS], high[2][SNES_BITS];
+    unsigned int passes, pass, i, pin;
+
+
+    passes = wiring->select_pin == SNES_NO_PIN ? 1 : 2;
+
+    // Set LATCH to high for 12 microseconds, so that every controller latches
+    // the state of its buttons
+    gpio_set(SNES_LATCH_PIN);
+    microsecond_delay(SNES_LATCH_TIME);
+    gpio_clear(SNES_LATCH_PIN);
+
+    for (pass = 0; pass < passes; pass++) {
+        // Switch the multitap over to its other two controllers
+        if (pass == 1) {
+            gpio_clear(wiring->select_pin);
+        }
+
+        // Output 16 clock pulses, sampling all the DATA lines at once on each
+        // falling edge
+        for (i = 0; i < SNES_BITS; i++) {
+            microsecond_delay(SNES_HALF_CYCLE);
+            gpio_clear(SNES_CLOCK_PIN);
+            samples[pass][i] = gpio_read_bank(0);
+            microsecond_delay(SNES_HALF_CYCLE);
+            gpio_set(SNES_CLOCK_PIN);
+        }
+    }
+
+    // Put the select line back high
+    if (passes == 2) {
+        gpio_set(wiring->select_pin);
+    }
+
+    // Transpose each pass's samples, as two 16 x 16 matrices: one for pins
+    // 0 - 15 and one for pins 16 - 31. Afterwards, element n of a matrix holds
+    // the 16 bits read from pin n (or n + 16).
+    for (pass = 0; pass < passes; pass++) {
+        for (i = 0; i < SNES_BITS; i++) {
+            low[pass][i] = samples[pass][i] & 0xFFFF;
+            high[pass][i] = samples[pass][i] >> 16;
+        }
+        transpose16(low[pass]);
+        transpose16(high[pass]);
+    }
+
+    // Pick out each controller's bits. A 0 on the DATA line means pressed,
+    // so the bits are inverted.
+    for (i = 0; i < wiring->pads; i++) {
+        pin = wiring->data_pin[i];
+        pass = wiring->pass[i];
+        states[i] = ~(pin < 16 ? low[pass][pin] : high[pass][pin - 16]);
+    }
+}
+
+#endif
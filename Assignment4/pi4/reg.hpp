@@ -0,0 +1,164 @@
+// Typed registers and fields, for C++ code. Each register is a type that
+// knows its address, and each field a type that knows its register, shift,
+// and width, so the compiler works out every mask and shift, and rejects a
+// field used with the wrong register. Nothing here takes any space or time at
+// run time: with optimization on, each call below becomes the same loads and
+// stores as the hand-written C.
+//
+// Several field values for the same register can be combined with '|'. The
+// result is a single mask and value, so
+//
+//     pi4::modify(pi4::gpio::fsel<14>::of(GPIO_FUNCTION_ALT5) |
+//                 pi4::gpio::fsel<15>::of(GPIO_FUNCTION_ALT5));
+//
+// reads GPFSEL1 once and writes it once, and pi4::write() stores the combined
+// value without reading the register at all. Combining fields of different
+// registers does not compile.
+//
+// It needs C++17, and no library headers, since the firmware is built with
+// -nostdinc.
+
+#ifndef PI4_REG_HPP
+#define PI4_REG_HPP
+
+// This file is included since it defines MMIO_BASE and the GPIO values
+extern "C" {
+#include "../gpio.h"
+}
+
+namespace pi4 {
+
+// A 32-bit register, at an offset from MMIO_BASE (which is not a constant in
+// the host build, so the offset is what identifies the register)
+template <unsigned long Offset>
+struct reg {
+    static constexpr unsigned long offset = Offset;
+
+    static volatile unsigned int *address()
+    {
+        return (volatile unsigned int *)((unsigned long)MMIO_BASE + Offset);
+    }
+
+    static unsigned int read()
+    {
+        return *address();
+    }
+
+    static void write(unsigned int value)
+    {
+        *address() = value;
+    }
+};
+
+// Values for some of the bits of a register: the bits to change, and what to
+// change them to
+template <typename Reg>
+struct field_value {
+    unsigned int mask;
+    unsigned int bits;
+
+    // Combine two values. Where they overlap, the right-hand one wins.
+    constexpr field_value operator|(field_value other) const
+    {
+        return { mask | other.mask, (bits & ~other.mask) | other.bits };
+    }
+};
+
+// A field of Width bits, starting at bit Shift of a register
+template <typename Reg, unsigned int Shift, unsigned int Width>
+struct field {
+    static_assert(Width >= 1 && Shift + Width <= 32,
+                  "field does not fit in a 32-bit register");
+
+    using reg_type = Reg;
+    static constexpr unsigned int shift = Shift;
+    static constexpr unsigned int width = Width;
+    static constexpr unsigned int mask =
+        (Width == 32 ? ~0u : ((1u << Width) - 1)) << Shift;
+
+    // The field set to a value (which is cut down to the field's width)
+    static constexpr field_value<Reg> of(unsigned int value)
+    {
+        return { mask, (value << Shift) & mask };
+    }
+
+    // The field's current value
+    static unsigned int read()
+    {
+        return (Reg::read() & mask) >> Shift;
+    }
+};
+
+// Change the given fields of a register, leaving the others as they are: one
+// read and one write
+template <typename Reg>
+inline void modify(field_value<Reg> value)
+{
+    Reg::write((Reg::read() & ~value.mask) | value.bits);
+}
+
+// Write the given fields of a register, and zeros everywhere else: one write.
+// This is for registers such as GPSET0 and GPCLR0, where zeros do nothing.
+template <typename Reg>
+inline void write(field_value<Reg> value)
+{
+    Reg::write(value.bits);
+}
+
+// The GPIO registers, with the register and field for each pin worked out at
+// compile time (see gpio.h for the function and pull values)
+namespace gpio {
+
+constexpr unsigned long base = 0x00200000;
+
+// Function select: 10 pins per register, 3 bits per pin
+template <unsigned int Pin>
+struct fsel : field<reg<base + 0x00 + 4 * (Pin / 10)>, (Pin % 10) * 3, 3> {
+    static_assert(Pin < GPIO_PINS, "there is no such GPIO pin");
+};
+
+// Pull-up/pull-down: 16 pins per register, 2 bits per pin
+template <unsigned int Pin>
+struct pull : field<reg<base + 0xE4 + 4 * (Pin / 16)>, (Pin % 16) * 2, 2> {
+    static_assert(Pin < GPIO_PINS, "there is no such GPIO pin");
+};
+
+// Set, clear, and level: 32 pins per register, 1 bit per pin
+template <unsigned int Pin>
+struct set : field<reg<base + 0x1C + 4 * (Pin / 32)>, Pin % 32, 1> {
+    static_assert(Pin < GPIO_PINS, "there is no such GPIO pin");
+};
+
+template <unsigned int Pin>
+struct clear : field<reg<base + 0x28 + 4 * (Pin / 32)>, Pin % 32, 1> {
+    static_assert(Pin < GPIO_PINS, "there is no such GPIO pin");
+};
+
+template <unsigned int Pin>
+struct level : field<reg<base + 0x34 + 4 * (Pin / 32)>, Pin % 32, 1> {
+    static_assert(Pin < GPIO_PINS, "there is no such GPIO pin");
+};
+
+// Drive several pins in the same bank high, or low, with one store, e.g.
+// pi4::gpio::set_pins<9, 11>()
+template <unsigned int First, unsigned int... Rest>
+inline void set_pins()
+{
+    static_assert(((First / 32 == Rest / 32) && ...),
+                  "the pins must all be in the same bank");
+    pi4::write((set<First>::of(1) | ... | set<Rest>::of(1)));
+}
+
+template <unsigned int First, unsigned int... Rest>
+inline void clear_pins()
+{
+    static_assert(((First / 32 == Rest / 32) && ...),
+                  "the pins must all be in the same bank");
+    pi4::write((clear<First>::of(1) | ... | clear<Rest>::of(1)));
+}
+
+}   // namespace gpio
+
+}   // namespace pi4
+
+#endif
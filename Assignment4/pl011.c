@@ -0,0 +1,672 @@
+// The functions in this file implement the same communications system as
+// uart.c, but using the PL011 UART (UART0) instead of the Mini UART (UART1).
+// Only one of the two files is compiled into the program: this one is used
+// when the program is built using 'make UART=pl011'.
+//
+// The PL011 has 32-byte transmit and receive FIFOs (the Mini UART has only 8),
+// and its Baud rate is derived from a dedicated 48 MHz UART reference clock
+// using a fractional divisor, so it does not change if the VPU core clock is
+// scaled. This allows Baud rates from 115200 up to 3 Mbaud. The Baud rate is
+// set using the UART_BAUD symbol, which defaults to 921600.
+//
+// Once uart_enable_interrupts() has been called, the UART is driven by FIFO
+// trigger-level interrupts. The receive interrupt fires when the receive FIFO
+// is half full, and the receive timeout interrupt fires when characters have
+// been sitting in the FIFO for 32 bit periods without any more arriving. The
+// transmit interrupt fires when the transmit FIFO drains down to 1/8 full.
+//
+// Under Qemu, the PL011 is connected to the first serial port. The 'make run'
+// target takes care of this when UART=pl011.
+
+// This file is included since it defines the memory mapped I/O base address
+#include "gpio.h"
+
+// Header files
+#include "gic.h"
+#include "ringbuf.h"
+#include "uart.h"
+
+// The addresses of the PL011 UART0 registers:
+//
+// These are defined on pages 144 - 146 of the Broadcom BCM2711 ARM Peripherals
+// manual. Note that we specify the ARM physical addresses of the peripherals,
+// which have the address range 0xFE000000 to 0xFEFFFFFF. These addresses are
+// mapped by the VideoCore Memory Management Unit (MMU) onto the bus addresses
+// in the range 0x7E000000 to 0x7EFFFFFF.
+#define UART0_DR        ((volatile unsigned int *)(MMIO_BASE + 0x00201000))
+#define UART0_RSRECR    ((volatile unsigned int *)(MMIO_BASE + 0x00201004))
+#define UART0_FR        ((volatile unsigned int *)(MMIO_BASE + 0x00201018))
+#define UART0_IBRD      ((volatile unsigned int *)(MMIO_BASE + 0x00201024))
+#define UART0_FBRD      ((volatile unsigned int *)(MMIO_BASE + 0x00201028))
+#define UART0_LCRH      ((volatile unsigned int *)(MMIO_BASE + 0x0020102C))
+#define UART0_CR        ((volatile unsigned int *)(MMIO_BASE + 0x00201030))
+#define UART0_IFLS      ((volatile unsigned int *)(MMIO_BASE + 0x00201034))
+#define UART0_IMSC      ((volatile unsigned int *)(MMIO_BASE + 0x00201038))
+#define UART0_RIS       ((volatile unsigned int *)(MMIO_BASE + 0x0020103C))
+#define UART0_MIS       ((volatile unsigned int *)(MMIO_BASE + 0x00201040))
+#define UART0_ICR       ((volatile unsigned int *)(MMIO_BASE + 0x00201044))
+
+// Fields in the Flag Register
+#define UART0_FR_BUSY   (0x1 << 3)      // Transmitting data
+#define UART0_FR_RXFE   (0x1 << 4)      // Receive FIFO empty
+#define UART0_FR_TXFF   (0x1 << 5)      // Transmit FIFO full
+#define UART0_FR_TXFE   (0x1 << 7)      // Transmit FIFO empty
+
+// Fields in the Interrupt Mask Set/Clear and Interrupt Clear Registers
+#define UART0_INT_RX    (0x1 << 4)      // Receive FIFO at trigger level
+#define UART0_INT_TX    (0x1 << 5)      // Transmit FIFO at trigger level
+#define UART0_INT_RT    (0x1 << 6)      // Receive timeout
+#define UART0_INT_ALL   0x7FF
+
+// The UART reference clock, which is set by the firmware (init_uart_clock in
+// config.txt), and the Baud rate
+#define UART0_CLOCK     48000000
+#ifndef UART_BAUD
+#define UART_BAUD       921600
+#endif
+
+// The Baud rate divisor is UART0_CLOCK / (16 * UART_BAUD), which has a 16-bit
+// integer part and a 6-bit fractional part. We calculate the divisor times 64
+// (rounded to the nearest integer), and split it into the two parts.
+#define UART0_DIVISOR   ((4 * UART0_CLOCK + UART_BAUD / 2) / UART_BAUD)
+#define UART0_IBRD_VAL  (UART0_DIVISOR >> 6)
+#define UART0_FBRD_VAL  (UART0_DIVISOR & 0x3F)
+
+// The depth of the PL011 transmit FIFO
+#define UART0_FIFO_SIZE         32
+
+// In benchmark builds, we count every read of a UART status register, so that
+// bench.c can report how many uncached MMIO reads are needed per byte sent
+#ifdef BENCHMARK
+static unsigned int mmio_reads;
+#define COUNT_MMIO_READ()       (mmio_reads++)
+#else
+#define COUNT_MMIO_READ()
+#endif
+
+// Sizes of the ring buffers used in interrupt-driven mode. These must be
+// powers of two.
+#define UART_TX_BUFFER_SIZE     1024
+#define UART_RX_BUFFER_SIZE     256
+
+// Ring buffers and state used in interrupt-driven mode
+static unsigned char tx_data[UART_TX_BUFFER_SIZE];
+static unsigned char rx_data[UART_RX_BUFFER_SIZE];
+static struct ringbuf tx_buffer, rx_buffer;
+static volatile int uart_async;
+static volatile unsigned int tx_overflows, rx_overflows;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function initializes the PL011 UART peripheral (UART0)
+//                  on the Raspberry Pi 4. First, the GPIO pins are set up so
+//                  that they map to UART0. Then the UART peripheral is
+//                  initialized to 8-bit mode with FIFOs enabled and the Baud
+//                  rate given by UART_BAUD. Finally, the UART transmitter and
+//                  receiver are enabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_init()
+{
+    static const struct gpio_pin_config pins[] = {
+        { 14, GPIO_FUNCTION_ALT0, GPIO_PULL_NONE },
+        { 15, GPIO_FUNCTION_ALT0, GPIO_PULL_NONE }
+    };
+    
+
+    // Disable the UART while it is being set up
+    *UART0_CR = 0;
+
+    // Map the PL011 UART (UART0) to GPIO pins 14 and 15, by setting them to
+    // alternate function 0, and disable their pull-up/pull-down control lines.
+    // The GPIO pins must be set up before initializing the UART. Pin 14 is
+    // treated as a UART TXD pin, and pin 15 as a UART RXD pin.
+    gpio_configure(pins, 2);
+
+
+
+    // Initialize the PL011 UART peripheral
+
+    // Clear any pending interrupts, and disable all of them
+    *UART0_ICR = UART0_INT_ALL;
+    *UART0_IMSC = 0;
+
+    // Set the Baud rate using the integer and fractional divisor registers
+    *UART0_IBRD = UART0_IBRD_VAL;
+    *UART0_FBRD = UART0_FBRD_VAL;
+
+    // Set the UART to work in 8-bit mode (bits 6:5 = 11), with 1 stop bit
+    // and no parity, and enable the transmit and receive FIFOs (bit 4). The
+    // divisor registers only take effect when this register is written.
+    *UART0_LCRH = (0x3 << 5) | (0x1 << 4);
+
+    // Set the FIFO interrupt trigger levels: the transmit interrupt fires when
+    // the transmit FIFO is 1/8 full or less (bits 2:0 = 000), and the receive
+    // interrupt fires when the receive FIFO is 1/2 full or more (bits
+    // 5:3 = 010)
+    *UART0_IFLS = (0x2 << 3) | (0x0 << 0);
+
+    // Enable the UART (bit 0), and its transmitter (bit 8) and receiver
+    // (bit 9)
+    *UART0_CR = (0x1 << 0) | (0x1 << 8) | (0x1 << 9);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_putc
+//
+//  Arguments:      c:     The character to write to the terminal
+//
+//  Returns:        void
+//
+//  Description:    This function polls the UART0 peripheral, waiting until
+//                  there is room in its transmit FIFO. The character c is then
+//                  sent to the console terminal over the TXD line. In
+//                  interrupt-driven mode, the character is written straight
+//                  into the FIFO if nothing is waiting ahead of it and there is
+//                  room, and otherwise it is put into the transmit ring buffer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_putc(unsigned int c)
+{
+    // In interrupt-driven mode, the interrupt handler only refills the FIFO
+    // from the ring buffer. The PL011 only raises the transmit interrupt when
+    // the FIFO drains past the trigger level, so we start things off by
+    // writing into the FIFO ourselves whenever the ring buffer is empty. This
+    // keeps the characters in order, since the handler never sends anything
+    // while the ring buffer is empty. If the FIFO is full, the transmit
+    // interrupt is certain to fire once it drains.
+    if (uart_async) {
+        if (ringbuf_empty(&tx_buffer) && !(*UART0_FR & UART0_FR_TXFF)) {
+            *UART0_DR = c;
+        } else if (!ringbuf_put(&tx_buffer, c)) {
+            tx_overflows++;
+        }
+        
+        return;
+    }
+
+    // Loop until the transmit FIFO buffer is able to accept a character for
+    // transmission. This will be true when the Transmit FIFO Full bit (bit 5)
+    // in the Flag Register is a 0 value.
+    do {
+    	// Use the NOP assembly language instruction in the loop body
+      	asm volatile("nop");
+        COUNT_MMIO_READ();
+    } while (*UART0_FR & UART0_FR_TXFF);
+    
+    // Write the character to the data register
+    *UART0_DR = c;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_rx_ready
+//
+//  Arguments:      none
+//
+//  Returns:        1 if a received character is waiting, or 0 otherwise
+//
+//  Description:    This function checks, without waiting, whether uart_getc()
+//                  would return a character straight away.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int uart_rx_ready()
+{
+    // In interrupt-driven mode, check the receive ring buffer
+    if (uart_async) {
+        return !ringbuf_empty(&rx_buffer);
+    }
+
+    // Otherwise check that the receive FIFO is not empty
+    return !(*UART0_FR & UART0_FR_RXFE);
+}
+
+
+ 
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_getc
+//
+//  Arguments:      none
+//
+//  Returns:        The character last received from the terminal
+//
+//  Description:    This function polls the UART0 peripheral, waiting for a
+//                  single character to be received from the console terminal
+//                  over the RXD line. If the character is a carriage return,
+//                  it is converted to a newline character. In interrupt-driven
+//                  mode, the character is taken from the receive ring buffer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+char uart_getc()
+{
+    char r;
+    unsigned char c;
+    
+    // In interrupt-driven mode, wait until the interrupt handler has put a
+    // character into the receive ring buffer
+    if (uart_async) {
+        while (!ringbuf_get(&rx_buffer, &c)) {
+            asm volatile("nop");
+        }
+        
+        return c == '\r' ? '\n' : c;
+    }
+
+    // Loop until an input character is available in the receive FIFO buffer.
+    // This is true when the Receive FIFO Empty bit (bit 4) in the Flag
+    // Register is a 0 value.
+    do {
+    	// Use the NOP assembly language instruction in the loop body
+        asm volatile("nop");
+    } while (*UART0_FR & UART0_FR_RXFE);
+
+    // Read the character from the data register. The upper bits hold error
+    // flags, which we ignore.
+    r = (char)(*UART0_DR & 0xFF);
+    
+    // Convert the carrige return character to a newline character, otherwise
+    // return the character unchanged
+    return r == '\r' ? '\n' : r;
+}
+
+
+ 
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_send
+//
+//  Arguments:      p:     A pointer to the characters to write
+//                  n:     The number of characters to write
+//                  crlf:  If non-zero, newlines are sent as CR/LF pairs
+//
+//  Returns:        void
+//
+//  Description:    This function writes n characters to the console terminal
+//                  using the TXD function of the UART0 peripheral. If crlf is
+//                  non-zero, each newline character is sent as a carriage
+//                  return followed by a newline. The PL011 does not report its
+//                  transmit FIFO fill level, but when the Flag Register shows
+//                  that the FIFO is empty we know that all 32 slots are free,
+//                  and can write that many characters without reading it again.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void uart_send(const unsigned char *p, size_t n, int crlf)
+{
+    unsigned int room, flags;
+    int cr_sent = 0;
+
+
+    // In interrupt-driven mode, hand the characters to uart_putc() one at a
+    // time, which writes them into the FIFO or the ring buffer as needed
+    if (uart_async) {
+        while (n--) {
+            if (crlf && *p == '\n')
+                uart_putc('\r');
+            uart_putc(*p++);
+        }
+        return;
+    }
+
+    // Keep going until all the characters have been written
+    while (n) {
+        // Find out how much room there is in the transmit FIFO: all of it if
+        // it is empty, at least one slot if it is not full, or none
+        COUNT_MMIO_READ();
+        flags = *UART0_FR;
+        if (flags & UART0_FR_TXFE) {
+            room = UART0_FIFO_SIZE;
+        } else if (!(flags & UART0_FR_TXFF)) {
+            room = 1;
+        } else {
+            room = 0;
+        }
+
+        // Write characters until the FIFO is full or we run out. A newline
+        // takes two slots, so we note when its carriage return has gone out
+        // in case the newline itself has to wait for the next burst.
+        while (room && n) {
+            if (crlf && *p == '\n' && !cr_sent) {
+                *UART0_DR = '\r';
+                cr_sent = 1;
+            } else {
+                *UART0_DR = *p++;
+                cr_sent = 0;
+                n--;
+            }
+            room--;
+        }
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_write
+//
+//  Arguments:      buf:   A pointer to the characters to write
+//                  n:     The number of characters to write
+//
+//  Returns:        void
+//
+//  Description:    This function writes n characters of text to the console
+//                  terminal. Each newline character is sent as a carriage
+//                  return followed by a newline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_write(const void *buf, size_t n)
+{
+    uart_send(buf, n, 1);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_write_binary
+//
+//  Arguments:      buf:   A pointer to the bytes to write
+//                  n:     The number of bytes to write
+//
+//  Returns:        void
+//
+//  Description:    This function writes n bytes of binary data over the UART
+//                  exactly as they are, without any newline translation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_write_binary(const void *buf, size_t n)
+{
+    uart_send(buf, n, 0);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_puts
+//
+//  Arguments:      s:     A pointer to the string to write to the console
+//
+//  Returns:        void
+//
+//  Description:    This function writes the specified string to the console
+//                  terminal using the TXD function of the UART0 peripheral.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_puts(char *s)
+{
+    size_t n = 0;
+
+    // Find the length of the string, up to the null terminating character
+    while (s[n])
+        n++;
+
+    // Write the whole string in bursts. This also sends a carriage return just
+    // before each newline.
+    uart_write(s, n);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_puthex
+//
+//  Arguments:      value:    The integer value to write to the console
+//
+//  Returns:        void
+//
+//  Description:    This function writes the specified unsigned integer value
+//                  to the console terminal using the TXD function of the UART0
+//                  peripheral. The unsigned integer value is 32 bits in size,
+//                  so 8 hexadecimal digits are written (without the 0x prefix).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_puthex(unsigned int value) 
+{
+    register unsigned int digit;
+    register int i;
+    char digits[8];
+
+    // Loop 8 times, isolating each 4-bit unit in turn, starting with the
+    // leftmost unit
+    for (i = 28 ; i >= 0; i -= 4) {
+        // Shift and mask the 4-bit unit so that it lays in the right most
+        // part of the register
+        digit = (value >> i) & 0xF;
+
+        // Convert the integer value into corresponding hexadecimal digit
+        if (digit > 9) {
+            // Convert the value into the digits A - F
+            digit += 0x37;
+        } else {
+            // Convert the value into the digits 0 - 9
+            digit += 0x30;
+        }
+
+        // Store the digit
+        digits[7 - i / 4] = digit;
+    }
+
+    // Write all 8 digits to the console terminal in one burst
+    uart_write(digits, 8);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_flush
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function waits until every character written so far
+//                  has been sent out over the TXD line. This is true when the
+//                  Transmit FIFO Empty bit (bit 7) in the Flag Register is a
+//                  1 value, and the Busy bit (bit 3) is a 0 value. In
+//                  interrupt-driven mode, we first wait for the transmit ring
+//                  buffer to empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_flush()
+{
+    // Wait for the interrupt handler to move everything out of the transmit
+    // ring buffer and into the FIFO
+    while (uart_async && !ringbuf_empty(&tx_buffer)) {
+        asm volatile("nop");
+    }
+
+    // Loop until the transmit FIFO buffer and the transmitter are both empty
+    do {
+    	// Use the NOP assembly language instruction in the loop body
+        asm volatile("nop");
+        COUNT_MMIO_READ();
+    } while ((*UART0_FR & (UART0_FR_TXFE | UART0_FR_BUSY)) != UART0_FR_TXFE);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_enable_interrupts
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function switches the UART into interrupt-driven mode.
+//                  The receive, receive timeout, and transmit interrupts are
+//                  enabled in the PL011, and the PL011 interrupt (ID 153) is
+//                  enabled in the GIC. The GIC must already have been set up
+//                  using gic_init(), and IRQ exceptions must be enabled on the
+//                  core for the UART to work in this mode.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_enable_interrupts()
+{
+    // Wait for any characters written in polled mode to go out
+    uart_flush();
+
+    // Start with empty ring buffers
+    ringbuf_init(&tx_buffer, tx_data, UART_TX_BUFFER_SIZE);
+    ringbuf_init(&rx_buffer, rx_data, UART_RX_BUFFER_SIZE);
+    tx_overflows = rx_overflows = 0;
+    uart_async = 1;
+
+    // Clear any pending interrupts, and enable the ones we use
+    *UART0_ICR = UART0_INT_ALL;
+    *UART0_IMSC = UART0_INT_RX | UART0_INT_RT | UART0_INT_TX;
+
+    // Register the PL011 interrupt handler, and enable it in the GIC
+    irq_register(GIC_PL011_IRQ_ID, uart_irq_handler, GIC_PRIORITY_LOW,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_tx_empty
+//
+//  Arguments:      none
+//
+//  Returns:        1 if the transmit ring buffer is empty, 0 if it is not
+//
+//  Description:    This function tells whether every character written so far
+//                  has been moved into the transmit FIFO. It is always true
+//                  when the UART is not interrupt-driven.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int uart_tx_empty()
+{
+    return ringbuf_empty(&tx_buffer);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_tx_drained
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called in interrupt-driven mode whenever
+//                  the last character in the transmit ring buffer has been
+//                  written into the transmit FIFO. This default version does
+//                  nothing. It is declared weak so that the program can define
+//                  its own version, e.g. to time how long output takes (see
+//                  latency.c).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((weak)) void uart_tx_drained()
+{
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called by the IRQ handler when the PL011
+//                  interrupt is pending. It moves all received characters
+//                  from the receive FIFO into the receive ring buffer, and
+//                  refills the transmit FIFO from the transmit ring buffer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_irq_handler()
+{
+    unsigned char c;
+    int sent;
+
+
+    // Empty the receive FIFO. This also clears the receive interrupt, and we
+    // clear the receive timeout interrupt explicitly.
+    while (!(*UART0_FR & UART0_FR_RXFE)) {
+        c = (unsigned char)(*UART0_DR & 0xFF);
+        if (!ringbuf_put(&rx_buffer, c)) {
+            rx_overflows++;
+        }
+    }
+    *UART0_ICR = UART0_INT_RX | UART0_INT_RT;
+
+    // Fill the transmit FIFO while it has room and we have characters to send.
+    // Filling it above the trigger level clears the transmit interrupt, but if
+    // we run out of characters first we must clear it ourselves.
+    sent = 0;
+    while (!(*UART0_FR & UART0_FR_TXFF) && ringbuf_get(&tx_buffer, &c)) {
+        *UART0_DR = c;
+        sent = 1;
+    }
+    if (ringbuf_empty(&tx_buffer)) {
+        *UART0_ICR = UART0_INT_TX;
+        if (sent) {
+            uart_tx_drained();
+        }
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_get_stats
+//
+//  Arguments:      stats:    A pointer to the structure to fill in
+//
+//  Returns:        void
+//
+//  Description:    This function reports the number of characters that were
+//                  dropped in interrupt-driven mode because the transmit or
+//                  receive ring buffer was full. In benchmark builds, it also
+//                  reports the number of status register reads made while
+//                  transmitting in polled mode.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_get_stats(struct uart_stats *stats)
+{
+    stats->tx_overflows = tx_overflows;
+    stats->rx_overflows = rx_overflows;
+#ifdef BENCHMARK
+    stats->mmio_reads = mmio_reads;
+#else
+    stats->mmio_reads = 0;
+#endif
+}
@@ -0,0 +1,183 @@
+// The functions in this file send the state of the SNES controller to the host
+// as compact binary frames, instead of as hexadecimal text. The program uses
+// them when built using 'make REPORT=binary'. A decoder for the host is in the
+// host/ directory.
+//
+// Each report is made up of the following 9 bytes, with multi-byte values in
+// little-endian order:
+//
+//   byte 0       Sequence number, which counts up by one for every report
+//                (wrapping from 255 back to 0), so the host can detect
+//                reports that were lost
+//   bytes 1-2    Button mask, as returned by get_SNES()
+//   bytes 3-6    Low 32 bits of the time when the controller was read, in
+//                microseconds since reset (see now_us() in timebase.c)
+//   bytes 7-8    CRC-16/CCITT-FALSE of bytes 0-6 (polynomial 0x1021, initial
+//                value 0xFFFF)
+//
+// The report is then encoded using Consistent Overhead Byte Stuffing (COBS),
+// which removes all 0x00 bytes from it at the cost of one extra byte, and a
+// single 0x00 byte is sent after it as a frame delimiter. The host can
+// therefore always find the start of the next frame, even if it starts
+// reading part way through one, or if bytes are lost.
+
+// Header files
+#include "uart.h"
+#include "report.h"
+
+// The sequence number of the next report
+static unsigned char sequence;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       crc16
+//
+//  Arguments:      data:    A pointer to the bytes to check
+//                  n:       The number of bytes
+//
+//  Returns:        The CRC-16/CCITT-FALSE of the bytes
+//
+//  Description:    This function calculates a CRC one bit at a time. Reports
+//                  are short, so this is fast enough and avoids the need for a
+//                  512-byte lookup table.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned short crc16(const unsigned char *data, unsigned int n)
+{
+    unsigned short crc = 0xFFFF;
+    int bit;
+
+
+    while (n--) {
+        crc ^= (unsigned short)(*data++) << 8;
+        for (bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+
+    return crc;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       cobs_encode
+//
+//  Arguments:      in:      A pointer to the bytes to encode
+//                  n:       The number of bytes (less than 254)
+//                  out:     A pointer to where the encoded bytes are written,
+//                           which must have room for n + 1 bytes
+//
+//  Returns:        The number of encoded bytes
+//
+//  Description:    This function encodes a block of bytes using COBS. Each 0x00
+//                  byte is replaced by the distance to the next 0x00 byte (or
+//                  to the end of the block), and an extra byte at the start
+//                  holds the distance to the first one.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned int cobs_encode(const unsigned char *in, unsigned int n,
+                                unsigned char *out)
+{
+    unsigned int code_index = 0, write_index = 1;
+    unsigned char code = 1;
+
+
+    while (n--) {
+        if (*in == 0) {
+            // Finish the current run, and start a new one here
+            out[code_index] = code;
+            code_index = write_index++;
+            code = 1;
+        } else {
+            // Copy the byte into the current run
+            out[write_index++] = *in;
+            code++;
+        }
+        in++;
+    }
+
+    // Finish the last run
+    out[code_index] = code;
+
+    return write_index;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       report_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function resets the sequence number and sends a frame
+//                  delimiter, so that the host discards anything it received
+//                  before the first report (such as the start-up message).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void report_init()
+{
+    unsigned char delimiter = 0;
+
+    sequence = 0;
+    uart_write_binary(&delimiter, 1);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       report_send
+//
+//  Arguments:      buttons:     The button mask read from the controller
+//                  timestamp:   The time when the controller was read, in
+//                               microseconds
+//
+//  Returns:        void
+//
+//  Description:    This function builds a report, adds its CRC, encodes it
+//                  using COBS, and sends it with a trailing frame delimiter
+//                  in a single call to the UART.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void report_send(unsigned short buttons, unsigned int timestamp)
+{
+    unsigned char payload[REPORT_PAYLOAD_SIZE];
+    unsigned char frame[REPORT_FRAME_SIZE];
+    unsigned short crc;
+    unsigned int length;
+
+
+    // Build the report
+    payload[0] = sequence++;
+    payload[1] = buttons & 0xFF;
+    payload[2] = buttons >> 8;
+    payload[3] = timestamp & 0xFF;
+    payload[4] = (timestamp >> 8) & 0xFF;
+    payload[5] = (timestamp >> 16) & 0xFF;
+    payload[6] = timestamp >> 24;
+
+    // Add the CRC of everything before it
+    crc = crc16(payload, REPORT_PAYLOAD_SIZE - 2);
+    payload[7] = crc & 0xFF;
+    payload[8] = crc >> 8;
+
+    // Encode the report, add the delimiter, and send the frame
+    length = cobs_encode(payload, REPORT_PAYLOAD_SIZE, frame);
+    frame[length++] = 0;
+    uart_write_binary(frame, length);
+}
@@ -0,0 +1,13 @@
+// These are the function prototypes for sending binary SNES reports (see
+// report.c for a description of the frame format)
+
+// The number of bytes in a report before framing: a sequence number (1 byte),
+// the button mask (2 bytes), a timestamp (4 bytes), and a CRC (2 bytes)
+#define REPORT_PAYLOAD_SIZE     9
+
+// The largest number of bytes in a framed report: one byte of COBS overhead,
+// the payload, and the 0x00 delimiter
+#define REPORT_FRAME_SIZE       (REPORT_PAYLOAD_SIZE + 2)
+
+void report_init();
+void report_send(unsigned short buttons, unsigned int timestamp);
@@ -0,0 +1,89 @@
+// A ring buffer (circular queue) of bytes, used to pass data between normal
+// code and interrupt handlers without disabling interrupts. It is safe as long
+// as there is only one producer (which calls ringbuf_put) and one consumer
+// (which calls ringbuf_get).
+//
+// The size of the buffer must be a power of two. The head and tail indices
+// count up forever (wrapping around at 2^32), and are masked only when the
+// data array is accessed. This means the number of bytes in the buffer is
+// always (head - tail), and a full buffer can be told apart from an empty one
+// without wasting a slot.
+
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+struct ringbuf {
+    volatile unsigned int head;         // Written only by the producer
+    volatile unsigned int tail;         // Written only by the consumer
+    unsigned int mask;                  // Size of the data array - 1
+    unsigned char *data;
+};
+
+// Make sure a byte written into the data array is visible (to an interrupt
+// handler or another core) before the index that publishes it. The host build
+// runs on one thread, so only the compiler needs to be stopped from
+// reordering.
+#ifdef HOST
+#define RINGBUF_BARRIER()       asm volatile("" ::: "memory")
+#else
+#define RINGBUF_BARRIER()       asm volatile("dmb ish" ::: "memory")
+#endif
+
+// Initialize a ring buffer to use the given array, whose size must be a power
+// of two
+static inline void ringbuf_init(struct ringbuf *rb, unsigned char *data,
+                                unsigned int size)
+{
+    rb->head = 0;
+    rb->tail = 0;
+    rb->mask = size - 1;
+    rb->data = data;
+}
+
+// Return the number of bytes in the buffer
+static inline unsigned int ringbuf_count(struct ringbuf *rb)
+{
+    return rb->head - rb->tail;
+}
+
+// Return 1 if the buffer is empty, or 0 otherwise
+static inline int ringbuf_empty(struct ringbuf *rb)
+{
+    return rb->head == rb->tail;
+}
+
+// Add a byte to the buffer. Returns 1 if successful, or 0 if the buffer is full
+static inline int ringbuf_put(struct ringbuf *rb, unsigned char c)
+{
+    unsigned int head = rb->head;
+
+    if (head - rb->tail > rb->mask) {
+        return 0;
+    }
+
+    rb->data[head & rb->mask] = c;
+    RINGBUF_BARRIER();
+    rb->head = head + 1;
+
+    return 1;
+}
+
+// Remove a byte from the buffer and store it in *c. Returns 1 if successful,
+// or 0 if the buffer is empty
+static inline int ringbuf_get(struct ringbuf *rb, unsigned char *c)
+{
+    unsigned int tail = rb->tail;
+
+    if (tail == rb->head) {
+        return 0;
+    }
+
+    RINGBUF_BARRIER();
+    *c = rb->data[tail & rb->mask];
+    RINGBUF_BARRIER();
+    rb->tail = tail + 1;
+
+    return 1;
+}
+
+#endif
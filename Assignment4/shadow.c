@@ -0,0 +1,131 @@
+// The functions in this file change configuration registers (the GPIO
+// function select, pull-up/pull-down, and edge detect enable registers, and
+// the auxiliary peripherals enable register) by read-modify-write.
+//
+// Reading a peripheral register is slow: the load goes out over the
+// peripheral bus, which takes hundreds of CPU cycles, and the CPU cannot get
+// on with anything that depends on it until it comes back. When built using
+// 'make SHADOW=1' (which defines REG_SHADOW), a copy of each register is kept
+// in RAM instead, so that only the first change to a register reads it, and
+// every later change is a RAM read-modify-write plus one store to the
+// register. This relies on nothing else changing the registers: if the
+// VideoCore firmware, another core, or code that writes the registers
+// directly may have done so, call shadow_sync() to read them all again.
+//
+// Without REG_SHADOW, each change reads the register itself, as usual.
+
+// Header files
+#include "gpio.h"
+#include "shadow.h"
+#include "sysreg.h"
+
+// The offset of each register from MMIO_BASE, in the order of the SHADOW_*
+// values in shadow.h
+static const unsigned int shadow_offset[SHADOW_REGISTERS] = {
+    0x00200000, 0x00200004, 0x00200008,     // GPFSEL0 - GPFSEL2
+    0x0020000C, 0x00200010, 0x00200014,     // GPFSEL3 - GPFSEL5
+    0x002000E4, 0x002000E8,                 // GPPUPPDN0 - GPPUPPDN1
+    0x002000EC, 0x002000F0,                 // GPPUPPDN2 - GPPUPPDN3
+    0x0020004C, 0x00200050,                 // GPREN0 - GPREN1
+    0x00200058, 0x0020005C,                 // GPFEN0 - GPFEN1
+    0x00215004                              // AUX_ENABLE (see uart.c)
+};
+
+#define SHADOW_REGISTER(reg) \
+    ((volatile unsigned int *)((unsigned long)MMIO_BASE + shadow_offset[reg]))
+
+#ifdef REG_SHADOW
+// The copies of the registers, and a bit for each one that has been read
+static unsigned int shadow[SHADOW_REGISTERS];
+static unsigned int shadow_valid = 0;
+#endif
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       shadow_modify
+//
+//  Arguments:      reg:     The register (one of the SHADOW_* values)
+//                  clear:   The bits to clear
+//                  set:     The bits to set, after clearing
+//
+//  Returns:        void
+//
+//  Description:    This function changes some of the bits in a register,
+//                  leaving the others as they are. With REG_SHADOW defined,
+//                  the register is only read the first time it is changed
+//                  (or after shadow_sync()), and each change then takes a
+//                  single store to the register.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void shadow_modify(unsigned int reg, unsigned int clear, unsigned int set)
+{
+    register unsigned int r;
+#ifdef REG_SHADOW
+    unsigned int irq_masked;
+
+
+    // Keep the copy and the register in step, even if an interrupt handler
+    // changes the same register
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    // Read the register if we have no copy of it yet
+    if (!(shadow_valid & (0x1 << reg))) {
+        shadow[reg] = *SHADOW_REGISTER(reg);
+        shadow_valid |= (0x1 << reg);
+    }
+
+    // Change the copy, and write it to the register
+    r = (shadow[reg] & ~clear) | set;
+    shadow[reg] = r;
+    *SHADOW_REGISTER(reg) = r;
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+#else
+    r = *SHADOW_REGISTER(reg);
+    r = (r & ~clear) | set;
+    *SHADOW_REGISTER(reg) = r;
+#endif
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       shadow_sync
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function reads each register that has a copy in RAM
+//                  again, in case something other than shadow_modify() has
+//                  changed it. It does nothing without REG_SHADOW defined.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void shadow_sync()
+{
+#ifdef REG_SHADOW
+    unsigned int irq_masked, reg;
+
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    for (reg = 0; reg < SHADOW_REGISTERS; reg++) {
+        if (shadow_valid & (0x1 << reg)) {
+            shadow[reg] = *SHADOW_REGISTER(reg);
+        }
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+#endif
+}
@@ -0,0 +1,20 @@
+// These are the definitions and function prototypes for the shadow register
+// layer (see shadow.c), which keeps copies of write-mostly configuration
+// registers in RAM
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+// The registers that can be shadowed
+#define SHADOW_GPFSEL0          0       // Plus 0 - 5 for GPFSEL0 - GPFSEL5
+#define SHADOW_GPPUPPDN0        6       // Plus 0 - 3 for GPPUPPDN0 - GPPUPPDN3
+#define SHADOW_GPREN0           10      // Plus 0 - 1 for GPREN0 - GPREN1
+#define SHADOW_GPFEN0           12      // Plus 0 - 1 for GPFEN0 - GPFEN1
+#define SHADOW_AUX_ENABLE       14
+#define SHADOW_REGISTERS        15
+
+// Function prototypes
+void shadow_modify(unsigned int reg, unsigned int clear, unsigned int set);
+void shadow_sync();
+
+#endif
@@ -0,0 +1,222 @@
+// A model of the GIC-400's distributor and CPU interface, for a single core.
+//
+// An interrupt is pending while its device holds its line high (see
+// sim_gic_set_line()), or after it has been made pending through
+// GICD_ISPENDR. Reading GICC_IAR acknowledges the pending, enabled interrupt
+// with the highest priority (the lowest ID among equals), as long as it is
+// higher than the priority mask, and its group priority (the upper bits, as
+// set by GICC_BPR) is higher than that of any interrupt that is already
+// active. Writing its ID to GICC_EOIR makes it inactive again. The
+// configuration and target registers are only stored. As on the Pi 4, where
+// the firmware starts the program in the Non-secure state, the group
+// registers read as zero and ignore writes, so nothing can be routed to FIQ.
+
+#include "sim.h"
+
+#define GIC_BASE                0xFF841000UL
+
+// Distributor register offsets
+#define GICD_CTLR               0x000
+#define GICD_TYPER              0x004
+#define GICD_IIDR               0x008
+#define GICD_IGROUPR            0x080
+#define GICD_ISENABLER          0x100
+#define GICD_ICENABLER          0x180
+#define GICD_ISPENDR            0x200
+#define GICD_ICPENDR            0x280
+#define GICD_ISACTIVER          0x300
+#define GICD_ICACTIVER          0x380
+#define GICD_IPRIORITYR         0x400
+#define GICD_ITARGETSR          0x800
+#define GICD_END                0x1000
+
+// CPU interface register offsets
+#define GICC_CTLR               0x1000
+#define GICC_PMR                0x1004
+#define GICC_BPR                0x1008
+#define GICC_IAR                0x100C
+#define GICC_EOIR               0x1010
+#define GICC_RPR                0x1014
+#define GICC_HPPIR              0x1018
+
+#define SPURIOUS                1023
+#define WORDS                   (SIM_IRQS / 32)
+
+unsigned long sim_irq_counts[SIM_IRQS];
+
+static uint32_t dist_regs[GICD_END / 4];
+static uint32_t cpu_ctlr, pmr, bpr;
+static uint32_t enabled[WORDS], lines[WORDS], soft_pending[WORDS];
+static uint32_t active[WORDS];
+static unsigned char priority[SIM_IRQS];
+
+void sim_gic_set_line(unsigned int id, int level)
+{
+    if (level) {
+        lines[id / 32] |= 1U << (id % 32);
+    } else {
+        lines[id / 32] &= ~(1U << (id % 32));
+    }
+}
+
+// The priority of the highest-priority active interrupt, or 256 if none is
+// active
+static unsigned int running_priority(void)
+{
+    unsigned int id, p = 256;
+
+    for (id = 0; id < SIM_IRQS; id++) {
+        if (((active[id / 32] >> (id % 32)) & 1) && priority[id] < p) {
+            p = priority[id];
+        }
+    }
+    return p;
+}
+
+// The interrupt that reading GICC_IAR would acknowledge
+static unsigned int highest_pending(void)
+{
+    unsigned int id, word, best = SPURIOUS, best_priority = 256;
+    unsigned int running, group;
+    uint32_t ready;
+
+    if (!(dist_regs[GICD_CTLR / 4] & 1) || !(cpu_ctlr & 1)) {
+        return SPURIOUS;
+    }
+
+    // Only the group priority counts for preemption
+    running = running_priority();
+    group = (0xFF << (bpr + 1)) & 0xFF;
+    for (word = 0; word < WORDS; word++) {
+        ready = (lines[word] | soft_pending[word]) & enabled[word] &
+                ~active[word];
+        while (ready != 0) {
+            id = word * 32 + __builtin_ctz(ready);
+            ready &= ready - 1;
+            if (priority[id] < pmr && priority[id] < best_priority &&
+                (running > 0xFF ||
+                 (priority[id] & group) < (running & group))) {
+                best_priority = priority[id];
+                best = id;
+            }
+        }
+    }
+    return best;
+}
+
+int sim_gic_signalled(void)
+{
+    return highest_pending() != SPURIOUS;
+}
+
+static uint32_t gic_read(uint64_t offset, int side_effects)
+{
+    unsigned int id, i;
+
+    // The set and clear registers read the same
+    i = (offset & 0x7F) / 4;
+    if (offset >= GICD_IGROUPR && offset < GICD_ISENABLER) {
+        return 0;
+    }
+    if (offset >= GICD_ISENABLER && offset < GICD_ISPENDR) {
+        return i < WORDS ? enabled[i] : 0;
+    }
+    if (offset >= GICD_ISPENDR && offset < GICD_ISACTIVER) {
+        return i < WORDS ? lines[i] | soft_pending[i] : 0;
+    }
+    if (offset >= GICD_ISACTIVER && offset < GICD_IPRIORITYR) {
+        return i < WORDS ? active[i] : 0;
+    }
+    if (offset >= GICD_IPRIORITYR && offset < GICD_IPRIORITYR + SIM_IRQS) {
+        i = offset - GICD_IPRIORITYR;
+        return priority[i] | (priority[i + 1] << 8) |
+               (priority[i + 2] << 16) | ((uint32_t)priority[i + 3] << 24);
+    }
+
+    switch (offset) {
+    case GICD_TYPER:
+        // ITLinesNumber: 32 * (N + 1) interrupts
+        return WORDS - 1;
+    case GICD_IIDR:
+        return 0x0200143B;
+    case GICC_CTLR:
+        return cpu_ctlr;
+    case GICC_PMR:
+        return pmr;
+    case GICC_BPR:
+        return bpr;
+    case GICC_IAR:
+        id = highest_pending();
+        if (side_effects && id != SPURIOUS) {
+            active[id / 32] |= 1U << (id % 32);
+            soft_pending[id / 32] &= ~(1U << (id % 32));
+            sim_irq_counts[id]++;
+        }
+        return id;
+    case GICC_RPR:
+        id = running_priority();
+        return id > 0xFF ? 0xFF : id;
+    case GICC_HPPIR:
+        return highest_pending();
+    default:
+        return offset < GICD_END ? dist_regs[offset / 4] : 0;
+    }
+}
+
+static void gic_write(uint64_t offset, uint32_t value)
+{
+    unsigned int i;
+
+    if (offset >= GICD_IGROUPR && offset < GICD_ISENABLER) {
+        // Ignored in the Non-secure state
+    } else if (offset >= GICD_ISENABLER &&
+               offset < GICD_ISENABLER + 4 * WORDS) {
+        enabled[(offset - GICD_ISENABLER) / 4] |= value;
+    } else if (offset >= GICD_ICENABLER &&
+               offset < GICD_ICENABLER + 4 * WORDS) {
+        enabled[(offset - GICD_ICENABLER) / 4] &= ~value;
+    } else if (offset >= GICD_ISPENDR && offset < GICD_ISPENDR + 4 * WORDS) {
+        soft_pending[(offset - GICD_ISPENDR) / 4] |= value;
+    } else if (offset >= GICD_ICPENDR && offset < GICD_ICPENDR + 4 * WORDS) {
+        soft_pending[(offset - GICD_ICPENDR) / 4] &= ~value;
+    } else if (offset >= GICD_ISACTIVER &&
+               offset < GICD_ISACTIVER + 4 * WORDS) {
+        active[(offset - GICD_ISACTIVER) / 4] |= value;
+    } else if (offset >= GICD_ICACTIVER &&
+               offset < GICD_ICACTIVER + 4 * WORDS) {
+        active[(offset - GICD_ICACTIVER) / 4] &= ~value;
+    } else if (offset >= GICD_IPRIORITYR &&
+               offset < GICD_IPRIORITYR + SIM_IRQS) {
+        for (i = 0; i < 4; i++) {
+            priority[offset - GICD_IPRIORITYR + i] = value >> (8 * i);
+        }
+    } else if (offset < GICD_END) {
+        dist_regs[offset / 4] = value;
+    } else if (offset == GICC_CTLR) {
+        cpu_ctlr = value;
+    } else if (offset == GICC_PMR) {
+        pmr = value & 0xFF;
+    } else if (offset == GICC_BPR) {
+        bpr = value & 0x7;
+    } else if (offset == GICC_EOIR) {
+        i = value & 0x3FF;
+        if (i < SIM_IRQS) {
+            active[i / 32] &= ~(1U << (i % 32));
+        }
+    }
+}
+
+static void gic_update(void)
+{
+}
+
+static uint64_t gic_next_event(void)
+{
+    return SIM_NEVER;
+}
+
+struct sim_device sim_gic_device = {
+    "gic", GIC_BASE, 0x2000,
+    gic_read, gic_write, gic_update, gic_next_event,
+    0, 0
+};
@@ -0,0 +1,306 @@
+// A model of the GPIO controller, with an SNES controller attached to pins 9
+// (LATCH), 11 (CLOCK) and 10 (DATA), as in snes.c.
+//
+// The level of each pin is its output latch if it is an output, the SNES
+// controller's DATA line for pin 10, and otherwise its pull-up or pull-down.
+// Whenever the levels change, rising and falling edges are latched into GPEDS
+// for the pins that have them enabled in GPREN/GPFEN (or GPAREN/GPAFEN), and
+// high and low levels are latched for the pins enabled in GPHEN/GPLEN. Each
+// bank raises its GIC interrupt while any of its GPEDS bits is set.
+//
+// The controller is a 4021 shift register. While LATCH is high it loads the
+// buttons, with a 0 for each one that is pressed, and puts the first (B) on
+// DATA. Each rising CLOCK edge while LATCH is low shifts the next one out.
+// After the 12 buttons come 4 bits that are always 1, and then 0s.
+//
+// The buttons follow a script, read by sim_snes_load_script(). Each line of it
+// gives a time in milliseconds since the start, and the buttons that are
+// pressed from then on, in the same form as the firmware's reports (e.g.
+// "250 0x0010" presses Up at 250 ms). A line "repeat <ms>" starts the script
+// again every <ms> milliseconds, and '#' starts a comment. The default script
+// presses each button in turn for 100 ms, with 100 ms between them.
+//
+// With the -l option, DATA is wired to pin 17 instead of the controller, as
+// for the latency harness (see latency.c).
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define GPIO_BASE               0xFE200000UL
+#define GPIO_PINS               58
+
+// Register offsets, divided by 4
+#define GPFSEL0                 (0x00 / 4)
+#define GPSET0                  (0x1C / 4)
+#define GPCLR0                  (0x28 / 4)
+#define GPLEV0                  (0x34 / 4)
+#define GPEDS0                  (0x40 / 4)
+#define GPREN0                  (0x4C / 4)
+#define GPFEN0                  (0x58 / 4)
+#define GPHEN0                  (0x64 / 4)
+#define GPLEN0                  (0x70 / 4)
+#define GPAREN0                 (0x7C / 4)
+#define GPAFEN0                 (0x88 / 4)
+#define GPPUPPDN0               (0xE4 / 4)
+#define GPIO_REGS               (0xF4 / 4)
+
+// Pull states in GPPUPPDN
+#define PULL_UP                 1
+#define PULL_DOWN               2
+
+// The SNES controller's pins, and the latency harness's stimulus pin
+#define LATCH_PIN               9
+#define DATA_PIN                10
+#define CLOCK_PIN               11
+#define LOOPBACK_PIN            17
+
+#define SCRIPT_MAX              1024
+
+int sim_loopback;
+unsigned long sim_snes_latches;
+
+static uint32_t regs[GPIO_REGS];
+static uint32_t out[2], levels[2];
+
+// The controller's shift register. Bit 0 is on the DATA line.
+static uint32_t shift = 0xFFFFFFFF;
+
+static struct {
+    uint64_t ms;
+    uint32_t buttons;
+} script[SCRIPT_MAX];
+static unsigned int script_length;
+static uint64_t script_repeat;
+
+// The default script
+static void default_script(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < 12; i++) {
+        script[2 * i].ms = i * 200 + 100;
+        script[2 * i].buttons = 1 << i;
+        script[2 * i + 1].ms = i * 200 + 200;
+        script[2 * i + 1].buttons = 0;
+    }
+    script_length = 24;
+    script_repeat = 12 * 200;
+}
+
+int sim_snes_load_script(const char *path)
+{
+    char line[256], *p;
+    unsigned long long ms;
+    unsigned int buttons;
+    FILE *f;
+    int n = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    script_length = 0;
+    script_repeat = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        n++;
+        p = strchr(line, '#');
+        if (p != NULL) {
+            *p = '\0';
+        }
+        if (sscanf(line, " repeat %llu", &ms) == 1) {
+            script_repeat = ms;
+        } else if (sscanf(line, " %llu %i", &ms, &buttons) == 2 &&
+                   script_length < SCRIPT_MAX &&
+                   (script_length == 0 ||
+                    ms >= script[script_length - 1].ms)) {
+            script[script_length].ms = ms;
+            script[script_length].buttons = buttons & 0x0FFF;
+            script_length++;
+        } else if (strspn(line, " \t\r\n") != strlen(line)) {
+            fprintf(stderr, "%s:%d: bad line\n", path, n);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// The buttons pressed at the current time, by the script
+static uint32_t script_buttons(void)
+{
+    uint64_t ms;
+    uint32_t buttons = 0;
+    unsigned int i;
+
+    if (script_length == 0) {
+        default_script();
+    }
+
+    ms = (sim_now - SIM_BOOT_NS) / 1000000;
+    if (script_repeat != 0) {
+        ms %= script_repeat;
+    }
+    for (i = 0; i < script_length && script[i].ms <= ms; i++) {
+        buttons = script[i].buttons;
+    }
+    return buttons;
+}
+
+static int is_output(unsigned int pin)
+{
+    return ((regs[GPFSEL0 + pin / 10] >> ((pin % 10) * 3)) & 0x7) == 1;
+}
+
+static unsigned int level(const uint32_t *l, unsigned int pin)
+{
+    return (l[pin / 32] >> (pin % 32)) & 1;
+}
+
+// Work out the level of every pin
+static void compute_levels(uint32_t *l)
+{
+    unsigned int pin, bit, pull;
+
+    l[0] = l[1] = 0;
+    for (pin = 0; pin < GPIO_PINS; pin++) {
+        if (is_output(pin)) {
+            bit = level(out, pin);
+        } else if (pin == DATA_PIN) {
+            if (sim_loopback) {
+                bit = is_output(LOOPBACK_PIN) ? level(out, LOOPBACK_PIN) : 0;
+            } else {
+                bit = shift & 1;
+            }
+        } else {
+            pull = (regs[GPPUPPDN0 + pin / 16] >> ((pin % 16) * 2)) & 0x3;
+            bit = pull == PULL_UP;
+        }
+        l[pin / 32] |= bit << (pin % 32);
+    }
+}
+
+// Bring the pin levels up to date, latching edges and levels into GPEDS, and
+// letting the SNES controller react to its LATCH and CLOCK lines
+static void gpio_update(void)
+{
+    static int reset = 1;
+    uint32_t l[2], rising, falling;
+    int i, b;
+
+    // Set the pulls to their values after reset: up for pins 0 - 8, and down
+    // for the rest
+    if (reset) {
+        reset = 0;
+        for (i = 0; i < GPIO_PINS; i++) {
+            regs[GPPUPPDN0 + i / 16] |=
+                (i < 9 ? PULL_UP : PULL_DOWN) << ((i % 16) * 2);
+        }
+    }
+
+    for (i = 0; i < 4; i++) {
+        // A high LATCH loads the buttons continuously
+        if (level(levels, LATCH_PIN)) {
+            shift = (~script_buttons() & 0x0FFF) | 0xF000;
+        }
+
+        compute_levels(l);
+        if (l[0] == levels[0] && l[1] == levels[1]) {
+            break;
+        }
+
+        for (b = 0; b < 2; b++) {
+            rising = l[b] & ~levels[b];
+            falling = ~l[b] & levels[b];
+            regs[GPEDS0 + b] |=
+                (rising & (regs[GPREN0 + b] | regs[GPAREN0 + b])) |
+                (falling & (regs[GPFEN0 + b] | regs[GPAFEN0 + b]));
+        }
+
+        if (level(l, LATCH_PIN) && !level(levels, LATCH_PIN)) {
+            sim_snes_latches++;
+        }
+        if (level(l, CLOCK_PIN) && !level(levels, CLOCK_PIN) &&
+            !level(l, LATCH_PIN)) {
+            shift >>= 1;
+        }
+
+        levels[0] = l[0];
+        levels[1] = l[1];
+    }
+
+    for (b = 0; b < 2; b++) {
+        regs[GPEDS0 + b] |= (levels[b] & regs[GPHEN0 + b]) |
+                            (~levels[b] & regs[GPLEN0 + b]);
+        sim_gic_set_line(SIM_IRQ_GPIO + b, regs[GPEDS0 + b] != 0);
+    }
+}
+
+static uint64_t gpio_next_event(void)
+{
+    return SIM_NEVER;
+}
+
+static uint32_t gpio_read(uint64_t offset, int side_effects)
+{
+    unsigned int i = offset / 4;
+
+    (void)side_effects;
+
+    if (i >= GPIO_REGS) {
+        return 0;
+    }
+    switch (i) {
+    case GPSET0:
+    case GPSET0 + 1:
+    case GPCLR0:
+    case GPCLR0 + 1:
+        return 0;
+    case GPLEV0:
+    case GPLEV0 + 1:
+        return levels[i - GPLEV0];
+    default:
+        return regs[i];
+    }
+}
+
+static void gpio_write(uint64_t offset, uint32_t value)
+{
+    unsigned int i = offset / 4;
+
+    if (i >= GPIO_REGS) {
+        return;
+    }
+    switch (i) {
+    case GPSET0:
+    case GPSET0 + 1:
+        out[i - GPSET0] |= value;
+        break;
+    case GPCLR0:
+    case GPCLR0 + 1:
+        out[i - GPCLR0] &= ~value;
+        break;
+    case GPLEV0:
+    case GPLEV0 + 1:
+        break;
+    case GPEDS0:
+    case GPEDS0 + 1:
+        // Writing a 1 clears a detected event
+        regs[i] &= ~value;
+        break;
+    default:
+        regs[i] = value;
+        break;
+    }
+    gpio_update();
+}
+
+struct sim_device sim_gpio_device = {
+    "gpio", GPIO_BASE, 0xF4,
+    gpio_read, gpio_write, gpio_update, gpio_next_event,
+    0, 0
+};
@@ -0,0 +1,412 @@
+// The core of the simulator: it reserves the simulated peripheral space,
+// catches accesses to modelled registers, keeps the simulated time, takes
+// interrupts, stands in for the system register functions in sysreg.s, and
+// runs the firmware. See sim.h for an overview.
+//
+// Usage:  kernel8-sim [-t seconds] [-a ns] [-s script] [-l]
+//
+//   -t  stop after this many seconds of simulated time, and print statistics
+//   -a  the time taken by each register access (default 50 ns)
+//   -s  read the SNES controller's buttons from a script (see gpio.c)
+//   -l  drive the SNES DATA line from GPIO 17, as for 'make LATENCY=1'
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "The simulator needs an x86-64 Linux host"
+#endif
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+// The trap flag in RFLAGS, which makes the processor stop after executing one
+// instruction, and the write bit in the page fault error code
+#define X86_RFLAGS_TF           0x100
+#define X86_PF_WRITE            0x2
+
+// The DAIF interrupt mask bits, as returned by getDAIF()
+#define DAIF_I                  0x2
+#define DAIF_F                  0x1
+#define DAIF_ALL                0xF
+
+// The firmware's entry point (its main(), renamed by the Makefile) and its
+// IRQ handler (see handlers.c)
+void firmware_main();
+void IRQ_handler();
+
+unsigned long sim_mmio_offset;
+uint64_t sim_now = SIM_BOOT_NS;
+uint64_t sim_access_ns = 50;
+
+static struct sim_device *devices[] = {
+    &sim_systimer_device,
+    &sim_gpio_device,
+    &sim_uart_device,
+    &sim_gic_device,
+};
+#define DEVICES (sizeof(devices) / sizeof(devices[0]))
+
+static unsigned char *mmio;
+static long page_size;
+
+// The register access that is being single-stepped
+static struct {
+    int active;
+    unsigned char *page;
+    volatile uint32_t *word;
+    struct sim_device *device;
+    uint64_t offset;
+    int write;
+} stepping;
+
+// The interrupt masks, which start off all set as they are at reset
+static unsigned int daif = DAIF_ALL;
+
+// Statistics
+static uint64_t time_limit, idle_ns;
+static unsigned long irqs_taken, wfi_count;
+static volatile sig_atomic_t interrupted;
+
+void sim_fatal(const char *message)
+{
+    fprintf(stderr, "kernel8-sim: %s\n", message);
+    exit(1);
+}
+
+// Bring all the models up to the current time
+void sim_update(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < DEVICES; i++) {
+        devices[i]->update();
+    }
+    sim_cntp_update();
+}
+
+// The earliest time at which a model might change by itself
+static uint64_t next_event(void)
+{
+    uint64_t next = sim_cntp_next_event(), t;
+    unsigned int i;
+
+    for (i = 0; i < DEVICES; i++) {
+        t = devices[i]->next_event();
+        if (t < next) {
+            next = t;
+        }
+    }
+    return next;
+}
+
+// Take interrupts for as long as one is signalled and IRQs are enabled. As on
+// the real processor, IRQs are masked while the handler runs.
+void sim_take_irqs(void)
+{
+    while (!(daif & DAIF_I) && sim_gic_signalled()) {
+        daif |= DAIF_I;
+        irqs_taken++;
+        IRQ_handler();
+        daif &= ~DAIF_I;
+    }
+}
+
+static struct sim_device *find_device(uint64_t address)
+{
+    unsigned int i;
+
+    for (i = 0; i < DEVICES; i++) {
+        if (address >= devices[i]->base &&
+            address < devices[i]->base + devices[i]->size) {
+            return devices[i];
+        }
+    }
+    return NULL;
+}
+
+// An access to a protected page of the simulated peripheral space. Put the
+// register's value in memory, unprotect the page, and single-step the
+// instruction.
+static void fault_handler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    unsigned char *p = info->si_addr;
+    uint64_t address;
+
+    (void)sig;
+
+    // A real crash: let it happen again with the default action
+    if (p < mmio || p >= mmio + (SIM_MMIO_END - SIM_MMIO_START) ||
+        stepping.active) {
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    address = SIM_MMIO_START + (p - mmio);
+    stepping.active = 1;
+    stepping.page = mmio + ((p - mmio) & ~(page_size - 1));
+    stepping.word = (volatile uint32_t *)(mmio + ((p - mmio) & ~3));
+    stepping.device = find_device(address & ~3ULL);
+    stepping.write = (uc->uc_mcontext.gregs[REG_ERR] & X86_PF_WRITE) != 0;
+
+    sim_now += sim_access_ns;
+    sim_update();
+
+    mprotect(stepping.page, page_size, PROT_READ | PROT_WRITE);
+    if (stepping.device != NULL) {
+        stepping.offset = (address & ~3ULL) - stepping.device->base;
+        *stepping.word = stepping.device->read(stepping.offset, !stepping.write);
+        if (stepping.write) {
+            stepping.device->writes++;
+        } else {
+            stepping.device->reads++;
+        }
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] |= X86_RFLAGS_TF;
+}
+
+// The instruction has been executed. Hand anything written to the model,
+// protect the page again, and take any interrupt that is now signalled.
+static void trap_handler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    (void)sig;
+    (void)info;
+
+    if (!stepping.active) {
+        signal(SIGTRAP, SIG_DFL);
+        return;
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~X86_RFLAGS_TF;
+    stepping.active = 0;
+    if (stepping.write && stepping.device != NULL) {
+        stepping.device->write(stepping.offset, *stepping.word);
+    }
+    mprotect(stepping.page, page_size, PROT_NONE);
+
+    sim_update();
+    sim_take_irqs();
+}
+
+static void interrupt_handler(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+static void report(void)
+{
+    unsigned int i;
+
+    sim_uart_exit();
+
+    fprintf(stderr, "\n%.6f s simulated in %.3f s of CPU time, %.1f%% idle\n",
+            (sim_now - SIM_BOOT_NS) / 1e9, (double)clock() / CLOCKS_PER_SEC,
+            100.0 * idle_ns / (sim_now - SIM_BOOT_NS));
+    fprintf(stderr, "%lu WFIs, %lu IRQs taken, %lu SNES latches\n",
+            wfi_count, irqs_taken, sim_snes_latches);
+    for (i = 0; i < DEVICES; i++) {
+        fprintf(stderr, "%-10s %10lu reads %10lu writes\n", devices[i]->name,
+                devices[i]->reads, devices[i]->writes);
+    }
+    for (i = 0; i < SIM_IRQS; i++) {
+        if (sim_irq_counts[i] != 0) {
+            fprintf(stderr, "IRQ %-6u %10lu\n", i, sim_irq_counts[i]);
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t seconds] [-a ns] [-s script] [-l]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction sa;
+    unsigned int i;
+    uint64_t first, last;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:a:s:l")) != -1) {
+        switch (opt) {
+        case 't':
+            time_limit = SIM_BOOT_NS + (uint64_t)(atof(optarg) * 1e9);
+            break;
+        case 'a':
+            sim_access_ns = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            if (sim_snes_load_script(optarg) < 0) {
+                return 1;
+            }
+            break;
+        case 'l':
+            sim_loopback = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    // Reserve the simulated peripheral space. Registers that are not
+    // modelled are just memory, but the pages holding modelled ones are
+    // protected, so that accessing them faults.
+    page_size = sysconf(_SC_PAGESIZE);
+    mmio = mmap(NULL, SIM_MMIO_END - SIM_MMIO_START, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mmio == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    sim_mmio_offset = (unsigned long)mmio - SIM_MMIO_START;
+    for (i = 0; i < DEVICES; i++) {
+        first = (devices[i]->base - SIM_MMIO_START) & ~(page_size - 1);
+        last = devices[i]->base - SIM_MMIO_START + devices[i]->size;
+        mprotect(mmio + first, last - first, PROT_NONE);
+    }
+
+    // The handlers must be able to interrupt themselves, since an interrupt
+    // handler taken after one access makes accesses of its own
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sa.sa_sigaction = fault_handler;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = trap_handler;
+    sigaction(SIGTRAP, &sa, NULL);
+    signal(SIGINT, interrupt_handler);
+
+    sim_uart_init();
+    atexit(report);
+
+    firmware_main();
+    return 0;
+}
+
+
+
+// The functions below stand in for the ones in sysreg.s. The simulated
+// processor is Core 0, running at EL1.
+
+unsigned int getCurrentEL()
+{
+    return 1;
+}
+
+unsigned int getCoreID()
+{
+    return 0;
+}
+
+unsigned int getSPSel()
+{
+    return 1;
+}
+
+unsigned int getNZCV()
+{
+    return 0;
+}
+
+unsigned int getDAIF()
+{
+    return daif;
+}
+
+void enableDAIF()
+{
+    daif = 0;
+    sim_take_irqs();
+}
+
+void disableDAIF()
+{
+    daif = DAIF_ALL;
+}
+
+void enableIRQ()
+{
+    daif &= ~DAIF_I;
+    sim_take_irqs();
+}
+
+void disableIRQ()
+{
+    daif |= DAIF_I;
+}
+
+void enableFIQ()
+{
+    daif &= ~DAIF_F;
+}
+
+void disableFIQ()
+{
+    daif |= DAIF_F;
+}
+
+// Sleep until an interrupt is signalled, even if IRQs are masked, by jumping
+// to the time of each device event in turn. The simulation stops here once
+// its time limit is reached, or when Ctrl-C is typed.
+void waitForInterrupt()
+{
+    uint64_t next;
+
+    wfi_count++;
+    sim_update();
+    while (!sim_gic_signalled()) {
+        next = next_event();
+        if (next == SIM_NEVER) {
+            sim_fatal("waitForInterrupt() with nothing to wake it up");
+        }
+        if (next > sim_now) {
+            idle_ns += next - sim_now;
+            sim_now = next;
+        }
+        sim_update();
+    }
+
+    if (interrupted || (time_limit != 0 && sim_now >= time_limit)) {
+        exit(0);
+    }
+
+    sim_take_irqs();
+}
+
+// A 1.5 GHz cycle counter
+void enableCycleCounter()
+{
+}
+
+unsigned long getCycleCount()
+{
+    return sim_now * 3 / 2;
+}
+
+// There are no caches or MMU to set up
+void invalidateDCache()
+{
+}
+
+void invalidateLocalDCache()
+{
+}
+
+void enableMMU(unsigned long ttbr0, unsigned long tcr, unsigned long mair)
+{
+    (void)ttbr0;
+    (void)tcr;
+    (void)mair;
+}
@@ -0,0 +1,117 @@
+// A register-level simulator that runs the firmware as an ordinary Linux
+// process, so that its loops can be run, debugged and profiled off-target. It
+// is built by typing 'make host' in the parent directory, which compiles the
+// firmware's C files with HOST defined, and links them with the files here
+// into kernel8-sim.
+//
+// With HOST defined, MMIO_BASE and GIC_BASE (see gpio.h and gic.h) point into
+// a block of memory that sim.c reserves, so the drivers are compiled
+// unchanged. The pages that hold modelled registers are protected, so every
+// access to them faults. The fault handler works out the register, asks the
+// device model for its value, lets the instruction run with the page
+// unprotected for a single step, and then hands anything written back to the
+// device model. Registers that are not modelled behave like memory.
+//
+// Time is simulated: each register access takes sim_access_ns, and each read
+// of the ARM generic timer's counter a little less. Code that does not touch
+// the hardware takes no time at all, and waitForInterrupt() jumps straight to
+// the next device event, so runs are fast and repeatable.
+//
+// Interrupts are taken between instructions that access a register, when
+// IRQs are enabled or the counter is read, and after waitForInterrupt(), by
+// calling the firmware's IRQ_handler() directly.
+//
+// The models are:
+//
+//   systimer.c  BCM System Timer (CLO, CHI, C0 - C3, CS), and the ARM generic
+//               timer's physical counter and EL1 timer
+//   gpio.c      GPIO function select, set/clear, levels, pulls, and edge and
+//               level detection into GPEDS, plus a scripted SNES controller
+//               (a 4021 shift register) on pins 9 (LATCH), 11 (CLOCK) and 10
+//               (DATA)
+//   uart.c      Mini UART, sending to standard output and receiving from
+//               standard input, with FIFOs that fill and drain at the Baud
+//               rate
+//   gic.c       GIC-400 distributor and CPU interface
+//
+// Only x86-64 Linux hosts are supported, since the fault handler uses the
+// page fault error code and the trap flag.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+// The range of physical addresses that are simulated: the main peripherals
+// and the GIC
+#define SIM_MMIO_START          0xFE000000UL
+#define SIM_MMIO_END            0xFF850000UL
+
+// GIC interrupt IDs (as in gic.h), up to the highest one that is modelled
+#define SIM_IRQ_CNTP            30
+#define SIM_IRQ_SYSTIMER        96      // Plus the channel number (0 - 3)
+#define SIM_IRQ_AUX             125
+#define SIM_IRQ_GPIO            145     // Plus the bank number (0 - 1)
+#define SIM_IRQS                256
+
+// The frequency of the simulated ARM generic timer, as on the Pi 4
+#define SIM_COUNTER_HZ          54000000UL
+
+// The simulated time when the firmware starts, in nanoseconds. The System
+// Timer on a real Pi has been running for a while by then, and the firmware
+// takes a counter value of 0 to mean that it is running under Qemu.
+#define SIM_BOOT_NS             1000000000ULL
+
+// No device event is pending
+#define SIM_NEVER               UINT64_MAX
+
+// A modelled block of registers. read() returns the value of the register at
+// the given offset; side_effects is 0 when the value is only needed because
+// the register is about to be written (or read and then written). write() is
+// given the whole 32-bit word after the write. update() brings the model up
+// to the current time, and next_event() gives the time of its next change
+// that might raise an interrupt.
+struct sim_device {
+    const char *name;
+    uint64_t base, size;
+    uint32_t (*read)(uint64_t offset, int side_effects);
+    void (*write)(uint64_t offset, uint32_t value);
+    void (*update)(void);
+    uint64_t (*next_event)(void);
+    unsigned long reads, writes;
+};
+
+// The simulated time, in nanoseconds
+extern uint64_t sim_now;
+
+// The time taken by each register access, in nanoseconds
+extern uint64_t sim_access_ns;
+
+// sim.c
+void sim_fatal(const char *message);
+void sim_update(void);
+void sim_take_irqs(void);
+
+// systimer.c
+extern struct sim_device sim_systimer_device;
+uint64_t sim_cntp_next_event(void);
+void sim_cntp_update(void);
+
+// gpio.c
+extern struct sim_device sim_gpio_device;
+int sim_snes_load_script(const char *path);
+extern int sim_loopback;
+extern unsigned long sim_snes_latches;
+
+// uart.c
+extern struct sim_device sim_uart_device;
+void sim_uart_init(void);
+void sim_uart_exit(void);
+
+// gic.c
+extern struct sim_device sim_gic_device;
+void sim_gic_set_line(unsigned int id, int level);
+int sim_gic_signalled(void);
+extern unsigned long sim_irq_counts[SIM_IRQS];
+
+#endif
@@ -0,0 +1,177 @@
+// Models of the two timers: the BCM System Timer, a 1 MHz counter with four
+// compare channels, and the ARM generic timer, whose 54 MHz physical counter
+// and EL1 physical timer are reached through sysreg.s on the Pi.
+
+#include "sim.h"
+
+// The System Timer's registers
+#define SYSTIMER_BASE           0xFE003000UL
+#define SYSTIMER_CS             0x00
+#define SYSTIMER_CLO            0x04
+#define SYSTIMER_CHI            0x08
+#define SYSTIMER_C0             0x0C
+
+// The CNTP_CTL_EL0 bits
+#define CNTP_CTL_ENABLE         0x1
+#define CNTP_CTL_IMASK          0x2
+
+// The time taken to read the generic timer's counter
+#define COUNTER_READ_NS         10
+
+static uint32_t cs, compare[4];
+static uint64_t checked_us = SIM_NEVER;     // Matches found up to this time
+
+static uint64_t cntp_cval;
+static uint32_t cntp_ctl;
+
+// The generic timer's counter value at the current time
+static uint64_t ticks(void)
+{
+    return (uint64_t)((unsigned __int128)sim_now * SIM_COUNTER_HZ /
+                      1000000000);
+}
+
+// Find the channels whose compare value the counter has reached since the
+// last update. A channel matches when the low 32 bits of the counter tick
+// over to its compare value, so one that is set to the current count does not
+// match until the counter wraps around.
+static void systimer_update(void)
+{
+    uint64_t now = sim_now / 1000, elapsed;
+    uint32_t wait;
+    int n;
+
+    if (checked_us == SIM_NEVER) {
+        checked_us = now;
+    }
+    elapsed = now - checked_us;
+    if (elapsed == 0) {
+        return;
+    }
+
+    for (n = 0; n < 4; n++) {
+        wait = compare[n] - (uint32_t)checked_us;
+        if ((wait != 0 && wait <= elapsed) || elapsed >= (1ULL << 32)) {
+            cs |= 1 << n;
+        }
+    }
+    checked_us = now;
+
+    for (n = 0; n < 4; n++) {
+        sim_gic_set_line(SIM_IRQ_SYSTIMER + n, (cs >> n) & 1);
+    }
+}
+
+static uint64_t systimer_next_event(void)
+{
+    uint64_t next = SIM_NEVER, t;
+    uint32_t wait;
+    int n;
+
+    for (n = 0; n < 4; n++) {
+        wait = compare[n] - (uint32_t)checked_us;
+        t = (checked_us + (wait != 0 ? wait : (1ULL << 32))) * 1000;
+        if (t < next) {
+            next = t;
+        }
+    }
+    return next;
+}
+
+static uint32_t systimer_read(uint64_t offset, int side_effects)
+{
+    (void)side_effects;
+
+    switch (offset) {
+    case SYSTIMER_CS:
+        return cs;
+    case SYSTIMER_CLO:
+        return (uint32_t)(sim_now / 1000);
+    case SYSTIMER_CHI:
+        return (uint32_t)(sim_now / 1000 >> 32);
+    default:
+        return compare[(offset - SYSTIMER_C0) / 4];
+    }
+}
+
+static void systimer_write(uint64_t offset, uint32_t value)
+{
+    int n;
+
+    switch (offset) {
+    case SYSTIMER_CS:
+        // Writing a 1 clears a match
+        cs &= ~value;
+        for (n = 0; n < 4; n++) {
+            sim_gic_set_line(SIM_IRQ_SYSTIMER + n, (cs >> n) & 1);
+        }
+        break;
+    case SYSTIMER_CLO:
+    case SYSTIMER_CHI:
+        break;
+    default:
+        compare[(offset - SYSTIMER_C0) / 4] = value;
+        break;
+    }
+}
+
+struct sim_device sim_systimer_device = {
+    "systimer", SYSTIMER_BASE, 0x1C,
+    systimer_read, systimer_write, systimer_update, systimer_next_event,
+    0, 0
+};
+
+
+
+// The EL1 physical timer raises its interrupt while it is enabled and not
+// masked, and the counter has reached the compare value
+void sim_cntp_update(void)
+{
+    sim_gic_set_line(SIM_IRQ_CNTP,
+                     (cntp_ctl & (CNTP_CTL_ENABLE | CNTP_CTL_IMASK)) ==
+                     CNTP_CTL_ENABLE && ticks() >= cntp_cval);
+}
+
+uint64_t sim_cntp_next_event(void)
+{
+    unsigned __int128 ns;
+
+    if ((cntp_ctl & (CNTP_CTL_ENABLE | CNTP_CTL_IMASK)) != CNTP_CTL_ENABLE ||
+        ticks() >= cntp_cval) {
+        return SIM_NEVER;
+    }
+
+    // The first time at which the counter reaches the compare value
+    ns = ((unsigned __int128)cntp_cval * 1000000000 + SIM_COUNTER_HZ - 1) /
+         SIM_COUNTER_HZ;
+    return ns > SIM_NEVER ? SIM_NEVER : (uint64_t)ns;
+}
+
+// The functions below stand in for the ones in timebase.h and sysreg.s that
+// use the generic timer. Reading the counter takes a little time, so that
+// loops which poll it make progress, and interrupts can be taken in them.
+
+unsigned long sim_counter()
+{
+    sim_now += COUNTER_READ_NS;
+    sim_update();
+    sim_take_irqs();
+    return ticks();
+}
+
+unsigned long getCounterFrequency()
+{
+    return SIM_COUNTER_HZ;
+}
+
+void setPhysicalTimerCompare(unsigned long value)
+{
+    cntp_cval = value;
+    sim_cntp_update();
+}
+
+void setPhysicalTimerControl(unsigned int value)
+{
+    cntp_ctl = value & (CNTP_CTL_ENABLE | CNTP_CTL_IMASK);
+    sim_cntp_update();
+}
@@ -0,0 +1,236 @@
+// A model of the Mini UART (UART1) in the auxiliary peripherals block.
+//
+// Characters written to AUX_MU_IO go to standard output straight away, but
+// they also pass through an 8-character transmit FIFO and a shift register
+// that send one character every 10 bit times at the Baud rate set in
+// AUX_MU_BAUD, so the FIFO fills up and drains as it does on the Pi. The
+// transmit interrupt is raised while the FIFO is empty.
+//
+// Standard input is read without blocking, at most one character per
+// millisecond, into an 8-character receive FIFO. If it is a terminal, it is
+// switched out of line mode, so that each key is sent as it is typed.
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define AUX_BASE                0xFE215000UL
+
+// Register offsets
+#define AUX_IRQ                 0x00
+#define AUX_ENABLES             0x04
+#define AUX_MU_IO               0x40
+#define AUX_MU_IER              0x44
+#define AUX_MU_IIR              0x48
+#define AUX_MU_LSR              0x54
+#define AUX_MU_STAT             0x64
+#define AUX_MU_BAUD             0x68
+#define AUX_REGS                (0x6C / 4)
+
+// AUX_MU_IER bits, AUX_MU_IIR FIFO clear bits, and AUX_MU_LSR bits
+#define IER_RX                  0x1
+#define IER_TX                  0x2
+#define IIR_CLEAR_RX            0x2
+#define IIR_CLEAR_TX            0x4
+#define LSR_DATA_READY          0x01
+#define LSR_TX_EMPTY            0x20
+#define LSR_TX_IDLE             0x40
+
+#define FIFO_SIZE               8
+
+// The VPU core clock, which the Baud rate is divided down from
+#define CORE_CLOCK_HZ           500000000ULL
+
+// How often standard input is checked for a character
+#define RX_POLL_NS              1000000
+
+static uint32_t regs[AUX_REGS];
+
+static unsigned char rx_fifo[FIFO_SIZE];
+static unsigned int rx_head, rx_count;
+static uint64_t rx_next_poll;
+static int rx_open = 1;
+
+static unsigned int tx_count;           // In the FIFO, not being sent
+static int tx_sending;                  // The shift register is busy
+static uint64_t tx_done;                // When it finishes its character
+
+static struct termios saved_termios;
+static int saved_flags, termios_saved;
+
+// The time taken to send one character: a start bit, 8 data bits, and a stop
+// bit at the Baud rate, which is core clock / (8 * (AUX_MU_BAUD + 1))
+static uint64_t char_ns(void)
+{
+    return 10 * 8 * (regs[AUX_MU_BAUD / 4] + 1ULL) * 1000000000 /
+           CORE_CLOCK_HZ;
+}
+
+static int irq_pending(void)
+{
+    return ((regs[AUX_MU_IER / 4] & IER_RX) && rx_count != 0) ||
+           ((regs[AUX_MU_IER / 4] & IER_TX) && tx_count == 0);
+}
+
+static void uart_update(void)
+{
+    unsigned char c;
+    ssize_t n;
+
+    // Send characters from the FIFO, one after another
+    while (tx_sending && sim_now >= tx_done) {
+        if (tx_count != 0) {
+            tx_count--;
+            tx_done += char_ns();
+        } else {
+            tx_sending = 0;
+        }
+    }
+
+    // Receive a character
+    if (rx_open && rx_count < FIFO_SIZE && sim_now >= rx_next_poll) {
+        rx_next_poll = sim_now + RX_POLL_NS;
+        n = read(0, &c, 1);
+        if (n == 1) {
+            rx_fifo[(rx_head + rx_count++) % FIFO_SIZE] = c;
+        } else if (n == 0) {
+            rx_open = 0;
+        }
+    }
+
+    sim_gic_set_line(SIM_IRQ_AUX, irq_pending());
+}
+
+static uint64_t uart_next_event(void)
+{
+    uint64_t next = SIM_NEVER;
+
+    if (tx_sending) {
+        next = tx_done;
+    }
+    if (rx_open && (regs[AUX_MU_IER / 4] & IER_RX) && rx_next_poll < next) {
+        next = rx_next_poll;
+    }
+    return next;
+}
+
+static uint32_t uart_read(uint64_t offset, int side_effects)
+{
+    uint32_t r;
+
+    switch (offset) {
+    case AUX_IRQ:
+        return irq_pending();
+    case AUX_MU_IO:
+        if (rx_count == 0) {
+            return 0;
+        }
+        r = rx_fifo[rx_head];
+        if (side_effects) {
+            rx_head = (rx_head + 1) % FIFO_SIZE;
+            rx_count--;
+            sim_gic_set_line(SIM_IRQ_AUX, irq_pending());
+        }
+        return r;
+    case AUX_MU_IIR:
+        // Bits 7:6 show that the FIFOs are enabled. Bits 2:1 give the reason
+        // for the interrupt, and bit 0 is clear while one is pending.
+        r = 0xC0;
+        if ((regs[AUX_MU_IER / 4] & IER_RX) && rx_count != 0) {
+            r |= 0x4;
+        } else if ((regs[AUX_MU_IER / 4] & IER_TX) && tx_count == 0) {
+            r |= 0x2;
+        } else {
+            r |= 0x1;
+        }
+        return r;
+    case AUX_MU_LSR:
+        r = 0;
+        if (rx_count != 0) {
+            r |= LSR_DATA_READY;
+        }
+        if (tx_count < FIFO_SIZE) {
+            r |= LSR_TX_EMPTY;
+        }
+        if (!tx_sending) {
+            r |= LSR_TX_IDLE;
+        }
+        return r;
+    case AUX_MU_STAT:
+        return (tx_count << 24) | (rx_count << 16) |
+               (!tx_sending << 9) | ((tx_count == 0) << 8) |
+               ((tx_count < FIFO_SIZE) << 1) | (rx_count != 0);
+    default:
+        return offset / 4 < AUX_REGS ? regs[offset / 4] : 0;
+    }
+}
+
+static void uart_write(uint64_t offset, uint32_t value)
+{
+    unsigned char c = value;
+
+    switch (offset) {
+    case AUX_IRQ:
+    case AUX_MU_LSR:
+    case AUX_MU_STAT:
+        break;
+    case AUX_MU_IO:
+        // A full FIFO drops the character
+        if (!tx_sending) {
+            tx_sending = 1;
+            tx_done = sim_now + char_ns();
+        } else if (tx_count < FIFO_SIZE) {
+            tx_count++;
+        } else {
+            break;
+        }
+        if (write(1, &c, 1) < 0) {
+            sim_fatal("cannot write to standard output");
+        }
+        break;
+    case AUX_MU_IIR:
+        if (value & IIR_CLEAR_RX) {
+            rx_count = 0;
+        }
+        if (value & IIR_CLEAR_TX) {
+            tx_count = 0;
+        }
+        break;
+    default:
+        if (offset / 4 < AUX_REGS) {
+            regs[offset / 4] = value;
+        }
+        break;
+    }
+    sim_gic_set_line(SIM_IRQ_AUX, irq_pending());
+}
+
+struct sim_device sim_uart_device = {
+    "uart", AUX_BASE, AUX_REGS * 4,
+    uart_read, uart_write, uart_update, uart_next_event,
+    0, 0
+};
+
+void sim_uart_init(void)
+{
+    struct termios t;
+
+    if (tcgetattr(0, &saved_termios) == 0) {
+        termios_saved = 1;
+        t = saved_termios;
+        t.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(0, TCSANOW, &t);
+    }
+    saved_flags = fcntl(0, F_GETFL);
+    fcntl(0, F_SETFL, saved_flags | O_NONBLOCK);
+}
+
+void sim_uart_exit(void)
+{
+    fcntl(0, F_SETFL, saved_flags);
+    if (termios_saved) {
+        tcsetattr(0, TCSANOW, &saved_termios);
+    }
+}
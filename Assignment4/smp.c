@@ -0,0 +1,36 @@
+// CPU Cores 1 - 3 are released from the firmware's spin table by the startup
+// code in startV2.s. Each core switches to EL1, sets up its own stacks and
+// exception vectors, turns on its MMU and caches, and then calls
+// secondary_main() with its core number (1 - 3).
+//
+// The version of secondary_main() in this file is only a default, which puts
+// the core back to sleep. A program that wants to use the other cores (for
+// example to poll the SNES controller on one core while writing to the UART
+// on another) provides its own secondary_main(), which replaces this one.
+
+// Header files
+#include "smp.h"
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       secondary_main
+//
+//  Arguments:      core_id:    The number of the CPU core (1 - 3)
+//
+//  Returns:        void
+//
+//  Description:    This is the default entry point for CPU Cores 1 - 3. It
+//                  simply puts the core to sleep forever. It is declared weak
+//                  so that the program can define its own version.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((weak)) void secondary_main(unsigned int core_id)
+{
+    // Loop forever, with the core asleep
+    while (1) {
+        asm volatile("wfe");
+    }
+}
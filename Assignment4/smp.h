@@ -0,0 +1,3 @@
+// These are the function prototypes for code that runs on CPU Cores 1 - 3
+
+void secondary_main(unsigned int core_id);
@@ -0,0 +1,448 @@
+// The functions in this file read the state of an SNES controller connected to
+// GPIO pins 9 (LATCH), 11 (CLOCK), and 10 (DATA).
+//
+// get_SNES() reads the controller directly, waiting through the 12
+// microsecond latch pulse and the 32 half-cycles of the clock, which takes
+// about 200 microseconds of CPU time. snes_start() does the same thing in the
+// background instead: a state machine, run by a software timer (see
+// swtimer.c), makes one change to the LATCH or CLOCK line per timer
+// interrupt, reading the DATA line on each falling clock edge. When all 16
+// bits have been read, the result is published as a timestamped sample, which
+// snes_get_sample() or snes_wait_sample() collect. Between edges the CPU is
+// free to do other work, or to sleep.
+//
+// When built using 'make SNES=spi' (which defines SNES_SPI), the SPI0
+// controller clocks the bits in instead, so each reading takes only a few
+// register accesses. SPI0 can only read its MISO input (GPIO 9), so the
+// controller's DATA and LATCH wires must be swapped over: DATA goes to
+// GPIO 9 and LATCH to GPIO 10. CLOCK stays on GPIO 11, which is SPI0_SCLK.
+// The SNES clock rests high, and the controller changes its DATA line on the
+// rising edge, so we use SPI mode 2 (CPOL = 1, CPHA = 0), which samples on
+// the falling edge, at about 83 kHz (a 12 microsecond period, as above). The
+// 16 bits arrive as two bytes, first bit in the top bit of the first byte.
+
+// Header files
+#include "gpio.h"
+#include "snes.h"
+#include "swtimer.h"
+#include "systimer.h"
+#include "timebase.h"
+#include "sysreg.h"
+#include "spi.h"
+
+// Timing of the controller signals, in microseconds
+#define SNES_LATCH_TIME         12      // Width of the latch pulse
+#define SNES_HALF_CYCLE         6       // Half a clock cycle
+#define SNES_BITS               16
+
+// The SPI0 clock divisor, which gives an 83.3 kHz SCLK from the VPU core
+// clock. The core clock runs at 500 MHz on the Pi 4, unless set otherwise
+// using 'core_freq' in config.txt, in which case SPI_CORE_CLOCK should be set
+// to match (e.g. 'make SNES=spi SPI_CORE_CLOCK=250000000').
+#ifndef SPI_CORE_CLOCK
+#define SPI_CORE_CLOCK          500000000
+#endif
+#define SNES_SPI_DIVISOR        (((SPI_CORE_CLOCK / 83333) + 1) & ~0x1)
+
+// The time taken by SPI0 to clock in all 16 bits, in microseconds
+#define SNES_SPI_TIME           (SNES_BITS * 2 * SNES_HALF_CYCLE)
+
+// States of the background reader. Between SNES_CLOCK_LOW and SNES_CLOCK_HIGH
+// the state machine goes round once for each bit.
+#define SNES_IDLE               0
+#define SNES_LATCH_HIGH         1       // LATCH is high; next: set it low
+#define SNES_CLOCK_HIGH         2       // CLOCK is high; next: set it low
+#define SNES_CLOCK_LOW          3       // CLOCK is low; next: set it high
+#define SNES_SPI_BUSY           4       // SPI0 is clocking in the bits
+
+// The controller's pins. When using SPI0, DATA and LATCH are swapped over.
+#ifdef SNES_SPI
+#define SNES_LATCH_PIN          10
+#define SNES_DATA_PIN           9
+#else
+#define SNES_LATCH_PIN          9
+#define SNES_DATA_PIN           10
+#endif
+#define SNES_CLOCK_PIN          11
+
+// Set and clear the LATCH line, and the CLOCK line, and read the DATA line
+#define set_LATCH()             gpio_set(SNES_LATCH_PIN)
+#define clear_LATCH()           gpio_clear(SNES_LATCH_PIN)
+#define set_CLOCK()             gpio_set(SNES_CLOCK_PIN)
+#define clear_CLOCK()           gpio_clear(SNES_CLOCK_PIN)
+#define get_DATA()              gpio_read(SNES_DATA_PIN)
+
+// The state of the background reader, which is changed by the timer callback
+static struct swtimer snes_timer;
+static volatile int state = SNES_IDLE;
+static int bit;
+static unsigned short buttons;
+static unsigned long latch_time;
+
+// The last published sample, and whether it has been collected yet
+static struct snes_sample latest;
+static volatile int sample_ready = 0;
+static unsigned int sequence = 0;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       publish
+//
+//  Arguments:      data:       The buttons read
+//                  timestamp:  The time the buttons were latched
+//
+//  Returns:        void
+//
+//  Description:    This function makes a completed reading available to
+//                  snes_get_sample(). Any earlier sample that has not been
+//                  collected is replaced.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void publish(unsigned short data, unsigned long timestamp)
+{
+    latest.buttons = data;
+    latest.sequence = sequence++;
+    latest.timestamp = timestamp;
+    sample_ready = 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       spi_buttons
+//
+//  Arguments:      none
+//
+//  Returns:        The buttons read, with a 1 bit for each button pressed
+//
+//  Description:    This function collects the two bytes clocked in by SPI0,
+//                  and reverses the order of their 16 bits, so that the first
+//                  bit received (which the SPI controller puts in the top bit)
+//                  ends up in bit 0, as in get_SNES().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned short spi_buttons()
+{
+    unsigned char bytes[2];
+    unsigned int r;
+
+
+    spi0_finish(bytes, 2);
+    r = (bytes[0] << 8) | bytes[1];
+
+    // Reverse the bits by swapping bytes, then nibbles, then pairs, then bits
+    r = ((r >> 8) & 0x00FF) | ((r & 0x00FF) << 8);
+    r = ((r >> 4) & 0x0F0F) | ((r & 0x0F0F) << 4);
+    r = ((r >> 2) & 0x3333) | ((r & 0x3333) << 2);
+    r = ((r >> 1) & 0x5555) | ((r & 0x5555) << 1);
+
+    // A 0 bit means the button is pressed
+    return ~r & 0xFFFF;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_edge
+//
+//  Arguments:      timer:   The software timer that called this function
+//                  arg:     Not used
+//
+//  Returns:        void
+//
+//  Description:    This function is the timer callback that runs the
+//                  background reader. Each call makes one change to the LATCH
+//                  or CLOCK line, exactly as get_SNES() does, and then starts
+//                  the timer again for the next change.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void snes_edge(struct swtimer *timer, void *arg)
+{
+    switch (state) {
+    case SNES_LATCH_HIGH:
+        // End the latch pulse. The first bit is now on the DATA line.
+        clear_LATCH();
+#ifdef SNES_SPI
+        // Let SPI0 clock in the bits, and come back when it should be done
+        spi0_start(2);
+        state = SNES_SPI_BUSY;
+        swtimer_start(timer, SNES_SPI_TIME, 0);
+        return;
+#else
+        state = SNES_CLOCK_HIGH;
+        break;
+#endif
+
+    case SNES_SPI_BUSY:
+        // Wait a little longer if the transfer is not quite finished
+        if (!spi0_done()) {
+            break;
+        }
+        state = SNES_IDLE;
+        publish(spi_buttons(), latch_time);
+        return;
+
+    case SNES_CLOCK_HIGH:
+        // Make a falling clock edge, and read the bit. A 0 means the button
+        // is pressed.
+        clear_CLOCK();
+        if (get_DATA() == 0) {
+            buttons |= (0x1 << bit);
+        }
+        state = SNES_CLOCK_LOW;
+        break;
+
+    case SNES_CLOCK_LOW:
+        // Make a rising clock edge, which makes the controller output the
+        // next bit
+        set_CLOCK();
+        bit++;
+        if (bit == SNES_BITS) {
+            // All the bits have been read
+            state = SNES_IDLE;
+            publish(buttons, latch_time);
+            return;
+        }
+        state = SNES_CLOCK_HIGH;
+        break;
+
+    default:
+        return;
+    }
+
+    swtimer_start(timer, SNES_HALF_CYCLE, 0);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sets up the GPIO pins used by the controller,
+//                  and the timer used by the background reader.
+//                  swtimer_init() must be called first.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void snes_init()
+{
+#ifdef SNES_SPI
+    static const struct gpio_pin_config pins[] = {
+        { SNES_LATCH_PIN, GPIO_FUNCTION_OUTPUT, GPIO_PULL_NONE }
+    };
+
+
+    // Clear the LATCH line to low, and set up its pin for output
+    clear_LATCH();
+    gpio_configure(pins, 1);
+
+    // Hand the DATA and CLOCK pins (9 and 11) over to SPI0, in mode 2, with
+    // the clock resting high
+    spi0_init(2, SNES_SPI_DIVISOR);
+#else
+    static const struct gpio_pin_config pins[] = {
+        { SNES_LATCH_PIN, GPIO_FUNCTION_OUTPUT, GPIO_PULL_NONE },
+        { SNES_DATA_PIN,  GPIO_FUNCTION_INPUT,  GPIO_PULL_NONE },
+        { SNES_CLOCK_PIN, GPIO_FUNCTION_OUTPUT, GPIO_PULL_NONE }
+    };
+
+
+    // Clear the LATCH line to low, and set the CLOCK line to high, before
+    // their pins become outputs
+    clear_LATCH();
+    set_CLOCK();
+
+    // Set up all three pins at once. They share Function Select Registers 0
+    // and 1, and pull-up/pull-down register 0.
+    gpio_configure(pins, 3);
+#endif
+
+    swtimer_setup(&snes_timer, snes_edge, 0);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_start
+//
+//  Arguments:      none
+//
+//  Returns:        1 if a reading was started, or 0 if one is already in
+//                  progress
+//
+//  Description:    This function starts reading the controller in the
+//                  background, and returns straight away. The result is
+//                  collected with snes_get_sample() or snes_wait_sample().
+//
+//                  The software timers run from the BCM System Timer. If it
+//                  is not running (under older versions of Qemu), the
+//                  controller is read at once using get_SNES() instead.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int snes_start()
+{
+    if (state != SNES_IDLE) {
+        return 0;
+    }
+
+    if (get_timer_counter() == 0) {
+        latch_time = now_us();
+        publish(get_SNES(), latch_time);
+        return 1;
+    }
+
+    // Start the latch pulse. The controller latches the state of its buttons,
+    // and the rest happens in snes_edge().
+    buttons = 0;
+    bit = 0;
+    latch_time = now_us();
+    state = SNES_LATCH_HIGH;
+    set_LATCH();
+    swtimer_start(&snes_timer, SNES_LATCH_TIME, 0);
+
+    return 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_get_sample
+//
+//  Arguments:      sample:  Where to copy the sample
+//
+//  Returns:        1 if a new sample was copied, or 0 if there is none
+//
+//  Description:    This function collects the most recent completed reading,
+//                  if it has not already been collected.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int snes_get_sample(struct snes_sample *sample)
+{
+    unsigned int irq_masked;
+    int ready;
+
+
+    // Stop the timer callback from publishing a sample while we copy it
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    ready = sample_ready;
+    if (ready) {
+        *sample = latest;
+        sample_ready = 0;
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+
+    return ready;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       snes_wait_sample
+//
+//  Arguments:      sample:  Where to copy the sample
+//
+//  Returns:        void
+//
+//  Description:    This function sleeps, using the WFI instruction, until a
+//                  new sample is available, and then collects it. A reading
+//                  must have been started with snes_start().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void snes_wait_sample(struct snes_sample *sample)
+{
+    // IRQs are disabled while checking for the sample and going to sleep, so
+    // that the last edge cannot happen just before the WFI instruction
+    disableIRQ();
+    while (!sample_ready) {
+        waitForInterrupt();
+        enableIRQ();
+        disableIRQ();
+    }
+    enableIRQ();
+
+    snes_get_sample(sample);
+}
+
+
+#ifdef SNES_SPI
+unsigned short get_SNES()
+{
+    // Pulse LATCH, and then let SPI0 clock in the 16 bits. We sleep while it
+    // does so, rather than polling its status register.
+    set_LATCH();
+    microsecond_delay(12);
+    clear_LATCH();
+    spi0_start(2);
+    microsecond_delay(SNES_SPI_TIME);
+
+    return spi_buttons();
+}
+#else
+unsigned short get_SNES()
+{
+    int i;
+    unsigned short data = 0;
+    unsigned int value;
+	
+	
+    // Set LATCH to high for 12 microseconds. This causes the controller to
+    // latch the values of button presses into its internal register. The first
+    // serial bit also becomes available on the DATA line.
+    set_LATCH();
+    microsecond_delay(12);
+    clear_LATCH();
+	
+    // Output 16 clock pulses, and read 16 bits of serial data
+	for (i = 0; i < 16; i++) {
+		// Delay 6 microseconds (half a cycle)
+		microsecond_delay(6);
+		
+		// Clear the CLOCK line (creates a falling edge)
+		clear_CLOCK();
+		
+		// Read the value on the input DATA line
+		value = get_DATA();
+		
+		// Store the bit read. Note we convert a 0 (which indicates a button
+		// press) to a 1 in the returned 16-bit integer. Unpressed buttons will
+		// be encoded as a 0.
+		if (value == 0) {
+	    	data |= (0x1 << i);
+		}
+		
+		// Delay 6 microseconds (half a cycle)
+		microsecond_delay(6);
+		
+		// Set the CLOCK to 1 (creates a rising edge). This causes the
+		// controller to output the next bit, which we read half a cycle later.
+		set_CLOCK();
+    }
+	
+    // Return the encoded data
+    return data;
+}
+#endif
+
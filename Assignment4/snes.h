@@ -0,0 +1,50 @@
+// These are the definitions and function prototypes for reading the SNES
+// controller (see snes.c)
+
+#ifndef SNES_H
+#define SNES_H
+
+// A completed reading of the controller
+struct snes_sample {
+    unsigned short buttons;         // A 1 bit for each button pressed
+    unsigned int sequence;          // Counts up by one for every sample
+    unsigned long timestamp;        // Time of the latch pulse (see now_us())
+};
+
+// The largest number of controllers read by snes_read_pads(): one plugged in
+// directly, plus four on a multitap
+#define SNES_MAX_PADS           5
+
+// Used in place of a GPIO pin number when there is no pin
+#define SNES_NO_PIN             0xFF
+
+// How several controllers are wired up for snes_read_pads(). All the
+// controllers share the LATCH (GPIO 9) and CLOCK (GPIO 11) lines, and each one
+// has a DATA pin, which must be one of GPIO 0 - 27 (bank 0).
+//
+// A multitap has two DATA lines (D0 and D1) and a select line. With select
+// high, D0 and D1 carry the bits of its first and second controllers, and
+// with select low those of its third and fourth, so it is read in two passes
+// of 16 clock pulses. Each controller is given the pass it is read in (0 or
+// 1); controllers not on a multitap are read in pass 0.
+struct snes_wiring {
+    unsigned int pads;                      // Number of controllers
+    unsigned char data_pin[SNES_MAX_PADS];  // DATA pin of each controller
+    unsigned char pass[SNES_MAX_PADS];      // Pass each one is read in
+    unsigned char select_pin;               // Multitap select, or SNES_NO_PIN
+};
+
+// Four controllers wired in parallel, and one controller plus a multitap
+extern const struct snes_wiring snes_wiring_parallel;
+extern const struct snes_wiring snes_wiring_multitap;
+
+// Function prototypes
+void snes_init();
+unsigned short get_SNES();
+int snes_start();
+int snes_get_sample(struct snes_sample *sample);
+void snes_wait_sample(struct snes_sample *sample);
+void snes_pads_init(const struct snes_wiring *wiring);
+void snes_read_pads(const struct snes_wiring *wiring, unsigned short *states);
+
+#endif
@@ -0,0 +1,135 @@
+// The functions in this file drive the SPI0 controller in polled mode, as an
+// SPI master. Only the clock (SCLK, GPIO 11) and input (MISO, GPIO 9) lines
+// are used; the chip select lines are left as ordinary GPIO pins.
+//
+// A transfer is split into two halves, so that the CPU does not have to wait
+// for the bits to be clocked in: spi0_start() loads the transmit FIFO and
+// starts the transfer, and spi0_finish() collects the received bytes once
+// spi0_done() says that the transfer is complete.
+
+// Header files
+#include "spi.h"
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       spi0_init
+//
+//  Arguments:      mode:     The SPI mode (0 - 3): bit 1 is the clock
+//                            polarity (CPOL) and bit 0 the clock phase (CPHA)
+//                  divisor:  The core clock divisor that sets the SCLK rate
+//                            (an even number from 2 to 65534)
+//
+//  Returns:        void
+//
+//  Description:    This function sets up the SPI0 controller, and then hands
+//                  GPIO pins 9 (MISO) and 11 (SCLK) over to it (alternate
+//                  function 0). The controller is set up first, so that SCLK
+//                  is already at its rest state when the pin is switched over.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void spi0_init(unsigned int mode, unsigned int divisor)
+{
+    static const struct gpio_pin_config pins[] = {
+        { 9,  GPIO_FUNCTION_ALT0, GPIO_PULL_NONE },
+        { 11, GPIO_FUNCTION_ALT0, GPIO_PULL_NONE }
+    };
+    register unsigned int r;
+
+
+    // Set the clock polarity and phase, and clear both FIFOs
+    r = SPI0_CS_CLEAR_TX | SPI0_CS_CLEAR_RX;
+    if (mode & 0x2) {
+        r |= SPI0_CS_CPOL;
+    }
+    if (mode & 0x1) {
+        r |= SPI0_CS_CPHA;
+    }
+    *SPI0_CS = r;
+
+    // Set the clock divisor. SCLK = core clock / divisor.
+    *SPI0_CLK = divisor;
+
+    // Set GPIO pins 9 (SPI0_MISO) and 11 (SPI0_SCLK) to alternate function 0
+    gpio_configure(pins, 2);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       spi0_start
+//
+//  Arguments:      n:        The number of bytes to transfer (at most 16,
+//                            the depth of the FIFO)
+//
+//  Returns:        void
+//
+//  Description:    This function starts a transfer of n bytes. Since only the
+//                  received bytes are wanted, zeros are sent.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void spi0_start(unsigned int n)
+{
+    // Clear the FIFOs and set the Transfer Active bit. The clock starts as
+    // soon as there are bytes in the transmit FIFO.
+    *SPI0_CS |= SPI0_CS_CLEAR_TX | SPI0_CS_CLEAR_RX | SPI0_CS_TA;
+
+    while (n--) {
+        *SPI0_FIFO = 0;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       spi0_done
+//
+//  Arguments:      none
+//
+//  Returns:        1 if the transfer is complete, or 0 otherwise
+//
+//  Description:    This function checks the DONE bit of the SPI0 Control and
+//                  Status register, without waiting.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int spi0_done()
+{
+    return (*SPI0_CS & SPI0_CS_DONE) != 0;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       spi0_finish
+//
+//  Arguments:      buf:      Where to put the received bytes
+//                  n:        The number of bytes that were transferred
+//
+//  Returns:        void
+//
+//  Description:    This function waits for the transfer to complete, reads
+//                  the received bytes from the FIFO, and ends the transfer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void spi0_finish(unsigned char *buf, unsigned int n)
+{
+    // Wait for the last byte to be clocked in
+    while (!spi0_done())
+        ;
+
+    // Read the received bytes
+    while (n--) {
+        *buf++ = (unsigned char)*SPI0_FIFO;
+    }
+
+    // Clear the Transfer Active bit
+    *SPI0_CS &= ~SPI0_CS_TA;
+}
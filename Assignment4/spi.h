@@ -0,0 +1,36 @@
+// The addresses of the SPI0 registers, and the function prototypes for using
+// them (see spi.c)
+//
+// These are defined on pages 133 - 140 of the Broadcom BCM2711 ARM Peripherals
+// Manual.
+
+#ifndef SPI_H
+#define SPI_H
+
+// This file is included since it defines the memory mapped I/O base address
+#include "gpio.h"
+
+#define SPI0_CS         ((volatile unsigned int *)(MMIO_BASE + 0x00204000))
+#define SPI0_FIFO       ((volatile unsigned int *)(MMIO_BASE + 0x00204004))
+#define SPI0_CLK        ((volatile unsigned int *)(MMIO_BASE + 0x00204008))
+#define SPI0_DLEN       ((volatile unsigned int *)(MMIO_BASE + 0x0020400C))
+#define SPI0_LTOH       ((volatile unsigned int *)(MMIO_BASE + 0x00204010))
+#define SPI0_DC         ((volatile unsigned int *)(MMIO_BASE + 0x00204014))
+
+// Bits in the SPI0 Control and Status register
+#define SPI0_CS_CPHA        (0x1 << 2)      // Clock phase
+#define SPI0_CS_CPOL        (0x1 << 3)      // Clock polarity (rest state)
+#define SPI0_CS_CLEAR_TX    (0x1 << 4)      // Clear the transmit FIFO
+#define SPI0_CS_CLEAR_RX    (0x1 << 5)      // Clear the receive FIFO
+#define SPI0_CS_TA          (0x1 << 7)      // Transfer active
+#define SPI0_CS_DONE        (0x1 << 16)     // Transfer complete
+#define SPI0_CS_RXD         (0x1 << 17)     // Receive FIFO is not empty
+#define SPI0_CS_TXD         (0x1 << 18)     // Transmit FIFO has space
+
+// Function prototypes
+void spi0_init(unsigned int mode, unsigned int divisor);
+void spi0_start(unsigned int n);
+int spi0_done();
+void spi0_finish(unsigned char *buf, unsigned int n);
+
+#endif
@@ -0,0 +1,502 @@
+// startV2:  This version demonstrates how to set up an environment that
+//           supports interrupt handling.
+//
+// This routine is used to establish an environment in which a C program can
+// run. CPU Core 0 runs the main() routine. CPU Cores 1 - 3 are held by the
+// firmware in a "spin table" until Core 0 releases them, after which each one
+// sets up its own environment and calls secondary_main(core_id).
+//
+// The stack pointer registers of each core are initialized to point into a
+// region just below the text section of the program, with Core 0 using the
+// region nearest to _start, and Core n using the region CORE_STACK_SIZE * n
+// bytes further down. Stacks grow backwards (toward 0). The top of each
+// region is used by exception handlers (SP_EL1), and the rest by normal code
+// (SP_EL0). All regions are aligned to the 64-byte cache line size, so cores
+// never share a line of stack memory.
+//
+// Core 0 also zeroes out all bytes in the .bss section, turns on the MMU and
+// caches, calls the constructors of any C++ global objects, and then branches
+// to the main() routine. The main() routine should never return to this code
+// (it should be in an infinite loop), but if it does, we then put the CPU core
+// into an infinite loop.
+//
+// Each core changes its exception level from EL2 to EL1 (in the aarch64
+// execution state). The exception vector table is also set up, and vector
+// stubs are provided. Only the IRQ and FIQ handlers are implemented. The IRQ
+// stub calls IRQ_handler(), and the FIQ stub calls the handler registered
+// with fiq_register() (see gic.c).
+//
+// The IRQ stub saves only the registers that a C function is allowed to
+// change (x0 - x18 and x30), since IRQ_handler() saves any of the others that
+// it uses itself. They go into a single 176-byte frame on the exception
+// stack, written with one stack pointer update. ELR_EL1 and SPSR_EL1 are
+// saved as well, since IRQ_handler() enables IRQs again while it runs a
+// low-priority interrupt's handler, and a higher-priority interrupt that
+// preempts it overwrites them. When assembled with
+// IRQ_FAST_RETURN defined ('make IRQ_FAST_RETURN=1'), the stub first checks
+// the GIC for a pending interrupt, and returns straight away if there is
+// none, without saving the rest of the registers or calling IRQ_handler().
+// When assembled with IRQ_TIMESTAMPS defined ('make irqbench'), the stub
+// first notes the time in irq_vector_ticks (see irqbench.c).
+//
+// FIQs are let in once the IRQ stub has saved ELR_EL1 and SPSR_EL1, so that the
+// single interrupt routed to FIQ is never held up by an IRQ handler, unless the
+// interrupted code had masked them. The FIQ stub saves the same registers as
+// the IRQ stub, since AArch64 has no banked FIQ registers, but it acknowledges
+// and ends the interrupt itself and calls the handler directly. If GICC_IAR
+// returns a different interrupt, which can happen since it also acknowledges
+// Group 1 interrupts, that interrupt's handler from the IRQ table is called
+// instead, or the interrupt is disabled if it has none. It does not save
+// ELR_EL1 and SPSR_EL1, since nothing can interrupt it.
+
+
+	// Sizes of the per-core stack regions, and the part of each region used
+	// by exception handlers
+	.equ	CORE_STACK_SIZE, 0x10000
+	.equ	EXCEPTION_STACK_SIZE, 0x2000
+
+	// The firmware's spin table. Core n (1 - 3) waits for a non-zero value
+	// to appear in the doubleword at SPIN_TABLE + (8 * n), and then jumps to
+	// that address.
+	.equ	SPIN_TABLE, 0xd8
+
+	// The IRQ stub's frame: x0 - x18 and x30 at offsets 0 - 159, followed by
+	// ELR_EL1 and SPSR_EL1. Its size is a multiple of 16 bytes, as SP must
+	// be. The FIQ stub's frame is the same, but keeps the value read from
+	// GICC_IAR in place of ELR_EL1.
+	.equ	IRQ_FRAME_SIZE, 176
+	.equ	IRQ_FRAME_ELR, 160
+	.equ	IRQ_FRAME_SPSR, 168
+	.equ	FIQ_FRAME_ACK, 160
+
+	// The address of the GIC CPU interface (see gic.h), in two halves, and
+	// the offsets of the registers that the stubs use in it
+	.equ	GICC_BASE_HIGH, 0xff84
+	.equ	GICC_BASE_LOW, 0x2000
+	.equ	GICC_IAR, 0x00c
+	.equ	GICC_EOIR, 0x010
+	.equ	GICC_HPPIR, 0x018
+
+	// The number of entries in gic_handlers[] (GIC_IRQS in gic.h)
+	.equ	GIC_IRQS, 256
+
+
+	// Put the machine code for this routine into the .text.boot section
+	.section ".text.boot"
+
+	// The _start symbol needs to be visible to the linker since this is
+        // where execution starts for bare metal code
+	.global _start
+_start:
+	// Copy the contents of the multiprocessor affinity register into the x0
+        // register. The rightmost 2 bits gives us the CPU Core number that this
+        // code is running on. Normally only CPU Core 0 arrives here, but if
+        // another core does, we make it wait in the spin table like the
+        // firmware would have done.
+	mrs     x0, mpidr_el1	// Read the MP affinity system register
+	and	x0, x0, 0x3	// Isolate the rightmost 2 bits
+	cbz	x0, core_zero	// Skip forward if both bits are 0
+
+	// If here, the CPU Core number is not 0. Wait until CPU Core 0 writes a
+	// start address into our entry in the spin table, and then jump to it.
+	mov	x1, SPIN_TABLE
+	add	x1, x1, x0, lsl 3	// x1 = SPIN_TABLE + (8 * core)
+spin:	wfe			// Wait for event puts the core to sleep
+	ldr	x2, [x1]
+	cbz	x2, spin	// Keep waiting while the entry is 0
+	br	x2
+
+	// We branch here if main() or secondary_main() ever returns
+loop:  	wfe			// Wait for event puts the core to sleep
+	b	loop		// Infinite loop
+
+  	// If here, the CPU Core is 0, and we continue with the rest of the
+  	// setup. We are running in EL2 currently, and will change to EL1 below.
+core_zero:
+
+	// Set the stack pointer to point to where the _start routine begins.
+        // The stack grows backwards (towards 0), so it uses memory that has
+        // lower addresses than the _start routine. We need to set this properly
+        // so that C functions and assembly routines can allocate stack frames.
+	adrp	x1, _start	// Put the _start address into x1
+	add	x1, x1, :lo12:_start
+
+	// Change to EL1. The top of the stack region is used by SP_EL1, and
+	// the rest by SP_EL0 (the stack we use from here on).
+	bl	drop_to_el1
+	sub	x1, x1, EXCEPTION_STACK_SIZE
+	mov	sp, x1
+
+	// Clear the .bss section using a loop. The __bss_start symbol indicates
+        // where in RAM the .bss section starts. The __bss_size symbol is also
+        // provided by the linker, and gives the size (in doublewords) of the
+        // .bss section.
+	adrp	x1, __bss_start		// Put address of .bss into x1
+	add	x1, x1, :lo12:__bss_start
+	ldr     w2, =__bss_size		// Put the size of the .bss section
+					// into w2, using a literal pool.
+					// w2 is our counter.
+
+top:	cbz     w2, endloop		// Exit loop if counter == 0
+	str     xzr, [x1], 8		// Write zeroes to RAM, x1 += 8
+	sub     w2, w2, 1		// Decrement counter (w2)
+	cbnz    w2, top			// Keep looping while counter != 0
+endloop:
+
+	// Build the translation tables, and turn on the MMU and the data and
+	// instruction caches. This must be done after the .bss section is
+	// cleared, since the tables live there.
+	bl	mmu_init
+
+	// Call the constructors of any C++ global objects. The linker collects
+	// pointers to them between __init_array_start and __init_array_end (see
+	// link.ld). This is done before the other cores are released, so that
+	// the objects are ready before any core uses them. x19 and x20 are kept
+	// safe by the constructors, since they are callee-saved registers.
+	adrp	x19, __init_array_start
+	add	x19, x19, :lo12:__init_array_start
+	adrp	x20, __init_array_end
+	add	x20, x20, :lo12:__init_array_end
+ctors:	cmp	x19, x20		// Exit loop once all have been called
+	b.hs	endctors
+	ldr	x1, [x19], 8		// Load the next pointer, x19 += 8
+	blr	x1			// Call the constructor
+	b	ctors
+endctors:
+
+	// Release CPU Cores 1 - 3 by writing the address of _secondary_start
+	// into their spin table entries. The entries share one cache line,
+	// which we clean out to RAM since the waiting cores still have their
+	// caches off. We then wake up the cores with a send event.
+	adrp	x1, _secondary_start
+	add	x1, x1, :lo12:_secondary_start
+	mov	x2, SPIN_TABLE
+	str	x1, [x2, 8]		// Core 1
+	str	x1, [x2, 16]		// Core 2
+	str	x1, [x2, 24]		// Core 3
+	dc	civac, x2
+	dsb	sy
+	sev
+
+	// Branch to the main() routine, which should never return
+  	bl      main
+
+	// We should never arrive here, but if we do we branch to the infinite
+        // loop above
+	b       loop
+
+
+
+	// CPU Cores 1 - 3 start executing here once they are released from the
+	// spin table. They are in EL2, with the MMU and caches off.
+_secondary_start:
+	// Keep the core number in x19, which is preserved by C functions
+	mrs	x19, mpidr_el1
+	and	x19, x19, 0x3
+
+	// Find the top of this core's stack region:
+	// x1 = _start - (CORE_STACK_SIZE * core)
+	adrp	x1, _start
+	add	x1, x1, :lo12:_start
+	mov	x2, CORE_STACK_SIZE
+	msub	x1, x19, x2, x1
+
+	// Change to EL1, and set up the stacks as for Core 0
+	bl	drop_to_el1
+	sub	x1, x1, EXCEPTION_STACK_SIZE
+	mov	sp, x1
+
+	// Turn on the MMU and caches for this core, using the translation
+	// tables that Core 0 has already built
+	bl	mmu_enable
+
+	// Branch to the secondary_main(core_id) routine, which should never
+	// return
+	mov	x0, x19
+	bl	secondary_main
+	b	loop
+
+
+
+	// This subroutine changes the exception level of the calling core from
+	// EL2 to EL1, and returns to the caller in EL1. On entry, x1 holds the
+	// address of the top of the core's stack region, which is used for the
+	// EL1 exception stack. Registers x0 and x2 are overwritten.
+drop_to_el1:
+	msr	sp_el1, x1	// Copy the address into the EL1 SP register
+
+	// Enable AArch64 in EL1 by setting bits RW and SWIC to 1 in the
+	// Hypervisor Configuration Register (see p. D10-2492 and D10-2503 in
+	// the ARM Architecture Reference Manual). Since all other bits are 0,
+	// most instructions are not trapped, and the Physical SError, IRQ, and
+	// FIQ routings are set so that these exceptions are not taken to EL2,
+	// but are instead handled at EL1.
+	mov	x0, (1 << 31)		// Enable AArch64
+	orr	x0, x0, (1 << 1)	// SWIO is hardwired on the Pi
+	msr	hcr_el2, x0
+
+	// Let EL1 read the physical counter and use the physical timer, by
+	// setting bits EL1PCTEN and EL1PCEN in the Counter-timer Hypervisor
+	// Control Register, and make the virtual counter equal the physical one
+	mov	x0, 0x3
+	msr	cnthctl_el2, x0
+	msr	cntvoff_el2, xzr
+
+	// Set the Vector Base Address Register (EL1) to the address of the
+	// vectors defined below
+	adrp	x2, _vectors
+	add	x2, x2, :lo12:_vectors
+	msr     vbar_el1, x2
+
+	// Change execution level to EL1:
+	//
+	// Set the Saved Program Status Register so that when entering EL1, the
+	// DAIF bits are set to 1111 (exceptions are masked) and the M[3:2] bits
+	// are set to 01 (EL1) and the M[0] bit is set to 0 (SP is always SP0)
+	// (see p. C5-386-387 in the ARM Architecture Reference Manual).
+	mov	x2, 0x3C4
+	msr	spsr_el2, x2
+
+	// Set the Exception Link Register EL2 to our return address, so that
+	// executing the exception return instruction forces the processor to
+	// change to EL1 and then return to the caller.
+	msr	elr_el2, x30
+	eret
+
+
+
+	// Exception handler stubs that are used by the vectors below.
+
+	// A stub that does nothing
+_synch_handler:
+	eret
+
+
+	// The IRQ stub. The vector has already pushed x0 and x1, making room
+	// for the whole frame.
+_IRQ_handler:
+.ifdef IRQ_TIMESTAMPS
+	// Note when the vector was entered, for the interrupt benchmarks
+	isb
+	mrs	x0, cntpct_el0
+	adrp	x1, irq_vector_ticks
+	str	x0, [x1, :lo12:irq_vector_ticks]
+.endif
+
+.ifdef IRQ_FAST_RETURN
+	// Return straight away if no interrupt is pending, which happens when
+	// IRQ_handler() has already dealt with the one that was signalled.
+	// IDs 1020 - 1023 mean that there is nothing pending.
+	movz	x0, GICC_BASE_HIGH, lsl 16
+	movk	x0, GICC_BASE_LOW
+	ldr	w0, [x0, GICC_HPPIR]
+	and	w0, w0, 0x3ff
+	cmp	w0, 1020
+	b.hs	_IRQ_return
+.endif
+
+	// Save the rest of the caller-saved registers, so that the C code that
+	// we call can use them
+	stp	x2, x3, [sp, 16]
+	stp	x4, x5, [sp, 32]
+	stp	x6, x7, [sp, 48]
+	stp	x8, x9, [sp, 64]
+	stp	x10, x11, [sp, 80]
+	stp	x12, x13, [sp, 96]
+	stp	x14, x15, [sp, 112]
+	stp	x16, x17, [sp, 128]
+	stp	x18, x30, [sp, 144]
+
+	// Save the return address and processor state, which a nested
+	// exception would overwrite
+	mrs	x0, elr_el1
+	mrs	x1, spsr_el1
+	stp	x0, x1, [sp, IRQ_FRAME_ELR]
+
+	// Let the FIQ in, now that it cannot overwrite them, unless the
+	// interrupted code had masked FIQs (bit 6 of SPSR_EL1, F)
+	tbnz	x1, 6, 1f
+	msr	DAIFClr, 0b0001
+1:
+	// Call the IRQ handler written in C. You must provide your own handler
+	// code, packaged as a C function.
+	bl	IRQ_handler
+
+	// Restore the return address and processor state, with IRQs masked
+	// again and FIQs masked too, and then the registers
+	msr	DAIFSet, 0b0001
+	ldp	x0, x1, [sp, IRQ_FRAME_ELR]
+	msr	elr_el1, x0
+	msr	spsr_el1, x1
+	ldp	x18, x30, [sp, 144]
+	ldp	x16, x17, [sp, 128]
+	ldp	x14, x15, [sp, 112]
+	ldp	x12, x13, [sp, 96]
+	ldp	x10, x11, [sp, 80]
+	ldp	x8, x9, [sp, 64]
+	ldp	x6, x7, [sp, 48]
+	ldp	x4, x5, [sp, 32]
+	ldp	x2, x3, [sp, 16]
+_IRQ_return:
+	ldp	x0, x1, [sp], IRQ_FRAME_SIZE
+
+	// Return from exception
+	eret
+
+
+	// The FIQ stub. The vector has already pushed x0 and x1, making room
+	// for the whole frame.
+_FIQ_handler:
+	// Save the rest of the caller-saved registers
+	stp	x2, x3, [sp, 16]
+	stp	x4, x5, [sp, 32]
+	stp	x6, x7, [sp, 48]
+	stp	x8, x9, [sp, 64]
+	stp	x10, x11, [sp, 80]
+	stp	x12, x13, [sp, 96]
+	stp	x14, x15, [sp, 112]
+	stp	x16, x17, [sp, 128]
+	stp	x18, x30, [sp, 144]
+
+	// Acknowledge the interrupt, and keep the value for the end of it.
+	// IDs 1020 - 1023 mean that there is nothing to acknowledge.
+	movz	x0, GICC_BASE_HIGH, lsl 16
+	movk	x0, GICC_BASE_LOW
+	ldr	w1, [x0, GICC_IAR]
+	str	x1, [sp, FIQ_FRAME_ACK]
+	and	w1, w1, 0x3ff
+	cmp	w1, 1020
+	b.hs	_FIQ_return
+
+	// Call the handler of the interrupt routed to FIQ. Since GICC_IAR
+	// also acknowledges Group 1 interrupts (AckCtl), it can return one
+	// that became pending first, whose handler is then looked up in
+	// gic_handlers[] instead (see gic.c). If it has none, it is disabled,
+	// as IRQ_handler() does.
+	adrp	x2, gic_fiq_id
+	ldr	w2, [x2, :lo12:gic_fiq_id]
+	cmp	w1, w2
+	b.ne	_FIQ_other
+	adrp	x2, gic_fiq_handler
+	ldr	x2, [x2, :lo12:gic_fiq_handler]
+	b	_FIQ_call
+_FIQ_other:
+	cmp	w1, GIC_IRQS
+	b.hs	_FIQ_unhandled
+	adrp	x2, gic_handlers
+	add	x2, x2, :lo12:gic_handlers
+	ldr	x2, [x2, x1, lsl 3]
+	cbz	x2, _FIQ_unhandled
+_FIQ_call:
+	blr	x2
+	b	_FIQ_eoi
+_FIQ_unhandled:
+	mov	w0, w1
+	bl	gic_disable
+
+	// Signal end of interrupt to the GIC
+_FIQ_eoi:
+	ldr	x1, [sp, FIQ_FRAME_ACK]
+	movz	x0, GICC_BASE_HIGH, lsl 16
+	movk	x0, GICC_BASE_LOW
+	str	w1, [x0, GICC_EOIR]
+
+	// Restore the registers, and return from exception
+_FIQ_return:
+	ldp	x18, x30, [sp, 144]
+	ldp	x16, x17, [sp, 128]
+	ldp	x14, x15, [sp, 112]
+	ldp	x12, x13, [sp, 96]
+	ldp	x10, x11, [sp, 80]
+	ldp	x8, x9, [sp, 64]
+	ldp	x6, x7, [sp, 48]
+	ldp	x4, x5, [sp, 32]
+	ldp	x2, x3, [sp, 16]
+	ldp	x0, x1, [sp], IRQ_FRAME_SIZE
+	eret
+
+	// A stub that does nothing
+_SError_handler:
+	eret
+
+
+
+
+	// Exception handler stub for exceptions that should never happen: any
+	// exception from a lower exception level, since all of the code runs in
+	// EL1. The core is parked, with the number of the vector (0 - 15) in x0,
+	// and the cause and address of the exception in x1 and x2, for a
+	// debugger to look at.
+_unexpected_handler:
+	mrs	x1, esr_el1
+	mrs	x2, elr_el1
+1:	wfe
+	b	1b
+
+
+
+	// Exception Vector Table:
+	//
+	// The start of the table must be aligned to an address evenly divisible
+	// by 2048 (i.e. it must end with 11 zeroes). Furthermore, each entry
+	// must also be aligned to an address evenly divisible by 128 (i.e. must
+	// end with 7 zeroes), and entries must follow each other consecutively
+	// in memory. Each vector can be as long as 32 instructions. There are
+	// four groups of four entries: exceptions taken from the current
+	// exception level while using SP_EL0 (which is how our code normally
+	// runs), from the current exception level while using SP_EL1 (in an
+	// exception handler), and from a lower exception level in AArch64 and
+	// in AArch32. The first two groups share the same handlers, and the
+	// last two should never be used.
+
+	// An IRQ vector. It pushes x0 and x1 in a new frame, and the stub
+	// stores the rest.
+	.macro	irq_vector
+	.align	7
+	stp	x0, x1, [sp, -IRQ_FRAME_SIZE]!
+	b	_IRQ_handler
+	.endm
+
+	// The FIQ vector, which works in the same way
+	.macro	fiq_vector
+	.align	7
+	stp	x0, x1, [sp, -IRQ_FRAME_SIZE]!
+	b	_FIQ_handler
+	.endm
+
+	// A vector that should never be used
+	.macro	unexpected_vector number
+	.align	7
+	mov	x0, \number
+	b	_unexpected_handler
+	.endm
+
+	.align 11
+_vectors:
+	// Current exception level, using SP_EL0: synchronous, IRQ, FIQ, SError
+	.align  7
+	b	_synch_handler	// Branch to handler stub defined above
+	irq_vector
+	fiq_vector
+	.align  7
+	b	_SError_handler	// Branch to handler stub defined above
+
+	// Current exception level, using SP_EL1
+	.align  7
+	b	_synch_handler
+	irq_vector
+	fiq_vector
+	.align  7
+	b	_SError_handler
+
+	// Lower exception level, using AArch64
+	unexpected_vector 8
+	unexpected_vector 9
+	unexpected_vector 10
+	unexpected_vector 11
+
+	// Lower exception level, using AArch32
+	unexpected_vector 12
+	unexpected_vector 13
+	unexpected_vector 14
+	unexpected_vector 15
@@ -0,0 +1,519 @@
+// The functions in this file provide any number of one-shot and periodic
+// software timers, all driven by a single hardware timer: compare channel C3
+// of the BCM System Timer. The compare register is always set to the time of
+// the next thing the timers need to do, so there is no periodic tick, and the
+// CPU is only interrupted when a timer is due.
+//
+// Pending timers are kept in a hierarchical timing wheel, which lets them be
+// started and cancelled in constant time. The wheel has WHEEL_LEVELS levels
+// of 64 slots. Each slot of level 0 holds the timers that expire in a
+// particular microsecond within the next 64 microseconds. Each slot of level 1
+// covers 64 microseconds within the next 4096, each slot of level 2 covers
+// 4096 microseconds, and so on. When the time reaches the start of a slot of
+// a higher level, its timers are "cascaded": moved down to the level below,
+// where they are spread out over the finer slots. Each level also keeps a
+// 64-bit map of which of its slots are in use, so finding the next time at
+// which anything happens takes a few bit operations per level, rather than a
+// scan over all the timers.
+//
+// With 5 levels the wheel covers 2^30 microseconds (about 18 minutes). Timers
+// further in the future than this are parked in the last slot that the wheel
+// reaches, and are put back into the wheel when that slot comes round.
+//
+// Times are values of the BCM System Timer counter (see get_timer_counter()),
+// which counts microseconds. The callbacks are called from the IRQ handler.
+
+// Header files
+#include "swtimer.h"
+#include "systimer.h"
+#include "sysreg.h"
+#include "gic.h"
+
+// The shape of the wheel
+#define WHEEL_BITS              6
+#define WHEEL_SLOTS             (1 << WHEEL_BITS)
+#define WHEEL_MASK              (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS            5
+#define WHEEL_RANGE             (1UL << (WHEEL_BITS * WHEEL_LEVELS))
+
+// Returned by next_event() when no timers are pending
+#define NO_EVENT                (~0UL)
+
+// The lists of timers in each slot, and the maps of which slots are in use
+static struct swtimer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static unsigned long occupied[WHEEL_LEVELS];
+
+// The earliest time that the wheel has not yet processed. Every timer in the
+// wheel was placed relative to this time.
+static unsigned long wheel_time;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       place
+//
+//  Arguments:      timer:   The timer to put into the wheel
+//
+//  Returns:        void
+//
+//  Description:    This function puts a timer into the slot that covers its
+//                  expiry time. The closer the expiry time is to wheel_time,
+//                  the lower the level it goes into. Timers that have already
+//                  expired go into the next slot to be processed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void place(struct swtimer *timer)
+{
+    unsigned long expires, delta;
+    unsigned int level, slot;
+
+
+    // Work out how far away the timer is, limited to what the wheel covers
+    expires = timer->expires;
+    if (expires < wheel_time) {
+        expires = wheel_time;
+    }
+    delta = expires - wheel_time;
+    if (delta >= WHEEL_RANGE) {
+        expires = wheel_time + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+
+    // Find the lowest level that reaches that far
+    level = 0;
+    while (delta >= (1UL << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    // Add the timer to the front of the slot's list
+    timer->next = wheel[level][slot];
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    wheel[level][slot] = timer;
+    timer->pprev = &wheel[level][slot];
+    timer->level = level;
+    timer->slot = slot;
+    timer->pending = 1;
+    occupied[level] |= 1UL << slot;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       unlink
+//
+//  Arguments:      timer:   A pending timer
+//
+//  Returns:        void
+//
+//  Description:    This function removes a timer from its slot.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void unlink(struct swtimer *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    if (wheel[timer->level][timer->slot] == 0) {
+        occupied[timer->level] &= ~(1UL << timer->slot);
+    }
+    timer->pending = 0;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       take_slot
+//
+//  Arguments:      level, slot:  The slot to empty
+//
+//  Returns:        The list of timers that were in the slot
+//
+//  Description:    This function removes all the timers from a slot at once.
+//                  They are still linked together through their next fields.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static struct swtimer *take_slot(unsigned int level, unsigned int slot)
+{
+    struct swtimer *list;
+
+
+    list = wheel[level][slot];
+    wheel[level][slot] = 0;
+    occupied[level] &= ~(1UL << slot);
+
+    return list;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       next_event
+//
+//  Arguments:      none
+//
+//  Returns:        The earliest time, at or after wheel_time, at which a slot
+//                  in use needs to be processed, or NO_EVENT
+//
+//  Description:    For each level, this function rotates the map of slots in
+//                  use so that the next slot to be processed is in bit 0, and
+//                  then counts the trailing zero bits to find the first slot
+//                  in use. A slot of level 0 is processed at the microsecond
+//                  it covers. A slot of a higher level is processed (cascaded)
+//                  at the start of the time it covers, which is the next one
+//                  after wheel_time unless wheel_time is exactly at the start
+//                  of the current one.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long next_event()
+{
+    unsigned long best = NO_EVENT, first, map, t;
+    unsigned int level, shift, start;
+
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        if (occupied[level] == 0) {
+            continue;
+        }
+
+        // Find the first slot that can still be processed
+        shift = WHEEL_BITS * level;
+        first = wheel_time >> shift;
+        if (wheel_time & ((1UL << shift) - 1)) {
+            first++;
+        }
+        start = first & WHEEL_MASK;
+
+        // Rotate the map, and find the first slot in use from there on
+        map = occupied[level];
+        if (start) {
+            map = (map >> start) | (map << (WHEEL_SLOTS - start));
+        }
+        t = (first + __builtin_ctzl(map)) << shift;
+
+        if (t < best) {
+            best = t;
+        }
+    }
+
+    return best;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       process
+//
+//  Arguments:      now:     The time to process the wheel up to
+//
+//  Returns:        void
+//
+//  Description:    This function processes every slot of the wheel that is
+//                  due at or before the given time, jumping straight from one
+//                  slot in use to the next. At each time it first cascades the
+//                  slots of the higher levels whose time has started, and then
+//                  calls the callbacks of the timers in the level 0 slot.
+//                  Periodic timers are put back into the wheel before their
+//                  callback is called, so the callback may cancel them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void process(unsigned long now)
+{
+    struct swtimer *list, *timer;
+    unsigned long t;
+    unsigned int level;
+
+
+    while ((t = next_event()) <= now) {
+        wheel_time = t;
+
+        // Cascade each higher level whose slot starts now. The lower level
+        // wraps round to slot 0 whenever a higher level changes slot.
+        for (level = 1; level < WHEEL_LEVELS; level++) {
+            if (t & ((1UL << (WHEEL_BITS * level)) - 1)) {
+                break;
+            }
+            list = take_slot(level, (t >> (WHEEL_BITS * level)) & WHEEL_MASK);
+            while (list) {
+                timer = list;
+                list = list->next;
+                place(timer);
+            }
+        }
+
+        // Take the timers that expire now, and move the wheel on, so that any
+        // timers started by the callbacks go into later slots. The taken list
+        // stays properly linked (through its head pointer), so a callback can
+        // still cancel one of the timers that has not been called yet.
+        list = take_slot(0, t & WHEEL_MASK);
+        if (list) {
+            list->pprev = &list;
+        }
+        wheel_time = t + 1;
+
+        while (list) {
+            timer = list;
+            list = list->next;
+            if (list) {
+                list->pprev = &list;
+            }
+            timer->pending = 0;
+
+            // A timer that was too far away for the wheel is not due yet
+            if (timer->expires > t) {
+                place(timer);
+                continue;
+            }
+
+            if (timer->period) {
+                timer->expires += timer->period;
+                place(timer);
+            }
+            timer->callback(timer, timer->arg);
+        }
+    }
+
+    // Nothing else is due before now, so skip the wheel forward
+    if (wheel_time <= now) {
+        wheel_time = now + 1;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       update
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function sets compare register C3 to the next time at
+//                  which the wheel needs processing. If that time has already
+//                  passed, the compare register will not match, so the C3
+//                  interrupt is set pending in the GIC instead. Must be called
+//                  with IRQs disabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void update()
+{
+    unsigned long next;
+
+
+    next = next_event();
+    if (next == NO_EVENT) {
+        return;
+    }
+
+    *SYSTEM_TIMER_C3 = (unsigned int)next;
+
+    if (get_timer_counter() >= next) {
+        *(GIC_GICD_ISPENDR + (GIC_SYSTIMER_C3_IRQ_ID / 32)) =
+            1 << (GIC_SYSTIMER_C3_IRQ_ID % 32);
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function empties the wheel, and enables the interrupt
+//                  for System Timer compare channel C3. It is given a high
+//                  priority, since the timer callbacks clock the SNES
+//                  controller, so it can preempt the UART's handler.
+//                  gic_init() must be called first.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_init()
+{
+    unsigned int level, slot;
+
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+            wheel[level][slot] = 0;
+        }
+        occupied[level] = 0;
+    }
+    wheel_time = get_timer_counter();
+
+    // Clear any match left over from before we started, and route the C3
+    // match interrupt to this core
+    *SYSTEM_TIMER_CS = SYSTEM_TIMER_CS_M3;
+    irq_register(GIC_SYSTIMER_C3_IRQ_ID, swtimer_irq_handler,
+                 GIC_PRIORITY_HIGH, GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called from the IRQ handler when System
+//                  Timer compare channel C3 matches. It clears the match, calls
+//                  the callbacks of the timers that are due, and sets the
+//                  compare register for the next one.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_irq_handler()
+{
+    *SYSTEM_TIMER_CS = SYSTEM_TIMER_CS_M3;
+
+    process(get_timer_counter());
+    update();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_setup
+//
+//  Arguments:      timer:     The timer to set up
+//                  callback:  The function to call when the timer fires
+//                  arg:       A value passed to the callback
+//
+//  Returns:        void
+//
+//  Description:    This function initializes a timer. It must be called once
+//                  before the timer is started.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_setup(struct swtimer *timer, swtimer_callback callback, void *arg)
+{
+    timer->next = 0;
+    timer->pprev = 0;
+    timer->pending = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_start_at
+//
+//  Arguments:      timer:     A timer set up by swtimer_setup()
+//                  expires:   The System Timer counter value when it fires
+//                  period:    The number of microseconds between later
+//                             firings, or 0 for a one-shot timer
+//
+//  Returns:        void
+//
+//  Description:    This function starts (or restarts) a timer. Periodic timers
+//                  fire at exactly expires + k * period, so they do not drift.
+//                  It may be called from a timer callback.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_start_at(struct swtimer *timer, unsigned long expires,
+                      unsigned int period)
+{
+    unsigned int irq_masked;
+
+
+    // The wheel is also changed by the IRQ handler
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (timer->pending) {
+        unlink(timer);
+    }
+    timer->expires = expires;
+    timer->period = period;
+    place(timer);
+    update();
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_start
+//
+//  Arguments:      timer:     A timer set up by swtimer_setup()
+//                  delay:     The number of microseconds until it fires
+//                  period:    The number of microseconds between later
+//                             firings, or 0 for a one-shot timer
+//
+//  Returns:        void
+//
+//  Description:    This function starts (or restarts) a timer, relative to the
+//                  current time.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_start(struct swtimer *timer, unsigned int delay,
+                   unsigned int period)
+{
+    swtimer_start_at(timer, get_timer_counter() + delay, period);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       swtimer_cancel
+//
+//  Arguments:      timer:     A timer set up by swtimer_setup()
+//
+//  Returns:        void
+//
+//  Description:    This function stops a timer. Nothing happens if the timer
+//                  is not pending. The compare register is left alone; if it
+//                  was set for this timer, the interrupt just finds nothing
+//                  to do.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void swtimer_cancel(struct swtimer *timer)
+{
+    unsigned int irq_masked;
+
+
+    irq_masked = getDAIF() & 0x2;
+    disableIRQ();
+
+    if (timer->pending) {
+        unlink(timer);
+    }
+
+    if (!irq_masked) {
+        enableIRQ();
+    }
+}
@@ -0,0 +1,36 @@
+// These are the definitions and function prototypes for the software timer
+// service (see swtimer.c)
+
+#ifndef SWTIMER_H
+#define SWTIMER_H
+
+struct swtimer;
+
+// The type of a timer's callback function. It is called from the IRQ handler,
+// so it must be short and must not sleep.
+typedef void (*swtimer_callback)(struct swtimer *timer, void *arg);
+
+// A software timer. The fields should only be changed by the functions in
+// swtimer.c.
+struct swtimer {
+    struct swtimer *next;           // Next timer in the same wheel slot
+    struct swtimer **pprev;         // The pointer that points to this timer
+    unsigned long expires;          // System Timer counter value when it fires
+    unsigned int period;            // Microseconds between firings, or 0
+    unsigned char level, slot;      // Where the timer is in the wheel
+    unsigned char pending;          // 1 while the timer is in the wheel
+    swtimer_callback callback;
+    void *arg;
+};
+
+// Function prototypes
+void swtimer_init();
+void swtimer_irq_handler();
+void swtimer_setup(struct swtimer *timer, swtimer_callback callback, void *arg);
+void swtimer_start(struct swtimer *timer, unsigned int delay,
+                   unsigned int period);
+void swtimer_start_at(struct swtimer *timer, unsigned long expires,
+                      unsigned int period);
+void swtimer_cancel(struct swtimer *timer);
+
+#endif
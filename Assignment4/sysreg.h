@@ -0,0 +1,27 @@
+//  C language function prototypes for the functions in sysreg.s, which are
+//  written in assembly
+
+unsigned int getCurrentEL();
+unsigned int getCoreID();
+unsigned int getSPSel();
+unsigned int getNZCV();
+unsigned int getDAIF();
+
+void enableDAIF();
+void disableDAIF();
+void enableIRQ();
+void disableIRQ();
+void enableFIQ();
+void disableFIQ();
+void waitForInterrupt();
+
+unsigned long getCounterFrequency();
+void setPhysicalTimerCompare(unsigned long value);
+void setPhysicalTimerControl(unsigned int value);
+
+void enableCycleCounter();
+unsigned long getCycleCount();
+
+void invalidateDCache();
+void invalidateLocalDCache();
+void enableMMU(unsigned long ttbr0, unsigned long tcr, unsigned long mair);
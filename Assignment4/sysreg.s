@@ -0,0 +1,233 @@
+//  This file provides functions to query and set various system registers. It
+//  is written in assembly code, since the system registers must be written to
+//  or read from using the msr and mrs instructions.
+
+
+		.text
+		.balign 4
+
+		.global getCurrentEL
+getCurrentEL:	mrs	x0, CurrentEL
+		lsr	x0, x0, 2
+		and	x0, x0, 0x3
+		ret
+
+
+		.global getCoreID
+getCoreID:	mrs	x0, mpidr_el1
+		and	x0, x0, 0x3
+		ret
+
+
+		.global getSPSel
+getSPSel:	mrs	x0, SPSel
+		ret
+
+
+		.global getNZCV
+getNZCV:	mrs	x0, NZCV
+		lsr	x0, x0, 28
+		and	x0, x0, 0xF
+		ret
+
+
+		.global getDAIF
+getDAIF:	mrs	x0, DAIF
+		lsr	x0, x0, 6
+		and	x0, x0, 0xF
+		ret
+
+
+		.global enableDAIF
+enableDAIF:	msr	DAIFClr, 0b1111
+		ret
+
+
+		.global disableDAIF
+disableDAIF:	msr	DAIFSet, 0b1111
+		ret
+
+
+		.global enableIRQ
+enableIRQ:	msr	DAIFClr, 0b0010
+		ret
+
+
+		.global disableIRQ
+disableIRQ:	msr	DAIFSet, 0b0010
+		ret
+
+
+		.global enableFIQ
+enableFIQ:	msr	DAIFClr, 0b0001
+		ret
+
+
+		.global disableFIQ
+disableFIQ:	msr	DAIFSet, 0b0001
+		ret
+
+
+		// Put the core into a low-power state until an interrupt is pending.
+		// This also wakes up if the interrupt is masked in DAIF, so it can be
+		// called with IRQs disabled to avoid missing a wake-up.
+		.global waitForInterrupt
+waitForInterrupt:
+		dsb	sy
+		wfi
+		ret
+
+
+		// Get the frequency of the ARM generic timer counter, in Hz
+		.global getCounterFrequency
+getCounterFrequency:
+		mrs	x0, cntfrq_el0
+		ret
+
+
+		// Set the compare value of the EL1 physical timer. The timer condition
+		// is met when CNTPCT_EL0 reaches this value.
+		.global setPhysicalTimerCompare
+setPhysicalTimerCompare:
+		msr	cntp_cval_el0, x0
+		isb
+		ret
+
+
+		// Set the control register of the EL1 physical timer (bit 0 ENABLE,
+		// bit 1 IMASK)
+		.global setPhysicalTimerControl
+setPhysicalTimerControl:
+		msr	cntp_ctl_el0, x0
+		isb
+		ret
+
+
+		// Enable the PMU cycle counter (PMCCNTR_EL0) so that it counts every
+		// CPU clock cycle, and reset it to 0
+		.global enableCycleCounter
+enableCycleCounter:
+		mrs	x0, pmcr_el0
+		orr	x0, x0, (1 << 0)	// E: enable all counters
+		orr	x0, x0, (1 << 2)	// C: reset the cycle counter
+		bic	x0, x0, (1 << 3)	// D: count every cycle (no divider)
+		msr	pmcr_el0, x0
+		mov	x0, (1 << 31)		// C: enable PMCCNTR_EL0
+		msr	pmcntenset_el0, x0
+		isb
+		ret
+
+
+		.global getCycleCount
+getCycleCount:	isb
+		mrs	x0, pmccntr_el0
+		ret
+
+
+		// Invalidate the data and unified caches by set/way, working through
+		// every cache level up to the Level of Coherency given in CLIDR_EL1
+		// (see p. D4-2489 in the ARM Architecture Reference Manual). This must
+		// only be done while the data cache is still off, since any dirty
+		// lines are thrown away rather than written back to memory. Since the
+		// L2 cache is shared by all cores, this must also only be done while
+		// the other cores are not running with their caches on.
+		.global invalidateDCache
+invalidateDCache:
+		mrs	x0, clidr_el1
+		and	w3, w0, 0x07000000	// Isolate the Level of Coherency
+		lsr	w3, w3, 23		// w3 = LoC * 2
+		b	dc_start
+
+		// As above, but only for the cache levels that are private to the
+		// calling core, i.e. up to the Level of Unification Inner Shareable
+		// (the L1 data cache on the Cortex-A72)
+		.global invalidateLocalDCache
+invalidateLocalDCache:
+		mrs	x0, clidr_el1
+		and	w3, w0, 0x00E00000	// Isolate the LoUIS
+		lsr	w3, w3, 20		// w3 = LoUIS * 2
+
+dc_start:	cbz	w3, dc_done
+		mov	w10, 0			// w10 = cache level * 2
+dc_level:	add	w2, w10, w10, lsr 1	// w2 = cache level * 3
+		lsr	w1, w0, w2
+		and	w1, w1, 0x7		// Cache type at this level
+		cmp	w1, 2
+		b.lt	dc_next_level		// Skip if there is no data cache
+		msr	csselr_el1, x10		// Select the cache level
+		isb
+		mrs	x1, ccsidr_el1
+		and	w2, w1, 0x7
+		add	w2, w2, 4		// w2 = log2(line length in bytes)
+		ubfx	w4, w1, 3, 10		// w4 = number of ways - 1
+		clz	w5, w4			// w5 = bit position of the way field
+		ubfx	w7, w1, 13, 15		// w7 = number of sets - 1
+dc_set:		mov	w9, w4			// Start with the highest way
+dc_way:		lsl	w6, w9, w5
+		orr	w11, w10, w6		// Combine the level and way
+		lsl	w6, w7, w2
+		orr	w11, w11, w6		// Combine the set
+		dc	isw, x11		// Invalidate this line
+		subs	w9, w9, 1
+		b.ge	dc_way
+		subs	w7, w7, 1
+		b.ge	dc_set
+dc_next_level:	add	w10, w10, 2
+		cmp	w3, w10
+		b.gt	dc_level
+dc_done:	dsb	sy
+		isb
+		ret
+
+
+		// Turn on the MMU, the data cache, and the instruction cache at the
+		// current exception level (EL1 or EL2). The arguments are the values
+		// to put into the translation table base register (x0), the
+		// translation control register (x1), and the memory attribute
+		// indirection register (x2). The TCR value is given in its EL1 form;
+		// the EL2 form has bits 31 and 23 as RES1, and EPD1 (bit 23 in EL1)
+		// lines up with one of them, so we only need to set bit 31.
+		.global enableMMU
+enableMMU:	mrs	x3, CurrentEL
+		lsr	x3, x3, 2
+		and	x3, x3, 0x3
+		cmp	x3, 2
+		b.ne	mmu_el1
+
+		// Running in EL2 (e.g. when using start.s)
+		orr	x1, x1, (1 << 31)
+		and	x1, x1, 0xFFFFFFFF	// Drop the EL1-only IPS/TBI fields
+		msr	mair_el2, x2
+		msr	tcr_el2, x1
+		msr	ttbr0_el2, x0
+		isb
+		tlbi	alle2
+		dsb	ish
+		isb
+		ic	iallu
+		mrs	x0, sctlr_el2
+		orr	x0, x0, (1 << 0)	// M: enable the MMU
+		orr	x0, x0, (1 << 2)	// C: enable the data cache
+		orr	x0, x0, (1 << 12)	// I: enable the instruction cache
+		bic	x0, x0, (1 << 1)	// A: no alignment checking
+		msr	sctlr_el2, x0
+		isb
+		ret
+
+		// Running in EL1 (e.g. when using startV2.s)
+mmu_el1:	msr	mair_el1, x2
+		msr	tcr_el1, x1
+		msr	ttbr0_el1, x0
+		isb
+		tlbi	vmalle1
+		dsb	ish
+		isb
+		ic	iallu
+		mrs	x0, sctlr_el1
+		orr	x0, x0, (1 << 0)	// M: enable the MMU
+		orr	x0, x0, (1 << 2)	// C: enable the data cache
+		orr	x0, x0, (1 << 12)	// I: enable the instruction cache
+		bic	x0, x0, (1 << 1)	// A: no alignment checking
+		msr	sctlr_el1, x0
+		isb
+		ret
@@ -1,22 +1,19 @@
-// The addresses of the BCM System Timer registers:
-//
-// These are defined on page 175 of the Broadcom BCM2711 ARM Peripherals Manual.
-// Note that we specify the ARM physical addresses of the peripherals, which
-// have the address range 0xFE000000 to 0xFEFFFFFF on the Pi 4.
-//
-// These addresses are mapped by the VideoCore Memory Management Unit (MMU) onto
-// the bus addresses in the range 0x7E000000 to 0x7EFFFFFF.
+// The functions in this file use the BCM System Timer, whose registers are
+// defined in systimer.h
 
-// This file is included since it defines the memory mapped I/O base address
-#include "gpio.h"
+// Header files
+#include "systimer.h"
+#include "gic.h"
+#include "sysreg.h"
 
-#define SYSTEM_TIMER_CS	    ((volatile unsigned int *)(MMIO_BASE + 0x00003000))
-#define SYSTEM_TIMER_CLO    ((volatile unsigned int *)(MMIO_BASE + 0x00003004))
-#define SYSTEM_TIMER_CHI    ((volatile unsigned int *)(MMIO_BASE + 0x00003008))
-#define SYSTEM_TIMER_C0     ((volatile unsigned int *)(MMIO_BASE + 0x0000300C))
-#define SYSTEM_TIMER_C1     ((volatile unsigned int *)(MMIO_BASE + 0x00003010))
-#define SYSTEM_TIMER_C2     ((volatile unsigned int *)(MMIO_BASE + 0x00003014))
-#define SYSTEM_TIMER_C3     ((volatile unsigned int *)(MMIO_BASE + 0x00003018))
+// Delays shorter than this (in microseconds) are busy-waited, since the time
+// taken to set up the timer interrupt and wake up from it would be a large
+// fraction of the delay
+#define SLEEP_MIN_INTERVAL  10
+
+// Set once the C1 compare interrupt has been enabled by systimer_init(). Until
+// then, all delays are busy-waited.
+static int sleep_enabled = 0;
 
 
 
@@ -56,46 +53,130 @@ unsigned long get_timer_counter()
 
 
 
- 
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       systimer_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function enables the interrupt for System Timer
+//                  compare channel C1 in the GIC, so that sleep_until() can
+//                  put the core to sleep instead of polling the timer. Channels
+//                  C0 and C2 are used by the VideoCore firmware, so we use C1.
+//                  gic_init() must be called first.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void systimer_init()
+{
+    // Clear any match left over from before we started
+    *SYSTEM_TIMER_CS = SYSTEM_TIMER_CS_M1;
+
+    // Route the C1 match interrupt to this core
+    irq_register(GIC_SYSTIMER_C1_IRQ_ID, systimer_irq_handler,
+                 GIC_DEFAULT_PRIORITY, GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+
+    sleep_enabled = 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       systimer_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called from the IRQ handler when System
+//                  Timer compare channel C1 matches. It clears the match, which
+//                  also removes the interrupt request. Nothing else needs to
+//                  be done, since the interrupt is only used to wake the core
+//                  up from sleep_until().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void systimer_irq_handler()
+{
+    *SYSTEM_TIMER_CS = SYSTEM_TIMER_CS_M1;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
-//  Function:       microsecond_delay
+//  Function:       sleep_until
 //
-//  Arguments:      interval:     The time to delay in microseconds
+//  Arguments:      deadline:     The value of the system timer counter to
+//                                wait for, in microseconds
 //
 //  Returns:        void
 //
-//  Description:    This function uses the BCM System Timer peripheral device
-//                  to delay the specified number of microseconds. This timer
-//                  is not emulated in Qemu, so this function returns
-//                  immediately (without delay) if this code is run under Qemu.
+//  Description:    This function waits until the system timer counter reaches
+//                  the given deadline. Instead of polling the counter, it sets
+//                  compare register C1 to the deadline and puts the core to
+//                  sleep with the WFI instruction until the match interrupt
+//                  (or any other interrupt) wakes it up. It returns at once if
+//                  the deadline has already passed.
+//
+//                  The counter is polled instead for delays shorter than
+//                  SLEEP_MIN_INTERVAL, before systimer_init() is called, when
+//                  IRQs are disabled, and on cores other than core 0 (since
+//                  the GIC only sends the interrupt to core 0). It returns at
+//                  once under Qemu, which does not emulate the System Timer.
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-void microsecond_delay(unsigned int interval)
+void sleep_until(unsigned long deadline)
 {
-    unsigned long current_counter, target_counter;
-	
-	
-    // Get the current value of the system timer counter
+    unsigned long current_counter;
+
+
+    // Get the current value of the system timer counter, which is always 0
+    // under Qemu
     current_counter = get_timer_counter();
-	
-    // Because Qemu does not emulate the system counter, the timer counter will
-    // always be 0 and we cannot use it to do timing (it will result in an
-    // infinite loop). In this case, we return immediately (without any delay).
-    if (current_counter == 0) {
+    if (current_counter == 0 || current_counter >= deadline) {
+        return;
+    }
+
+    // Poll the counter if the delay is short, or if we can't use the interrupt
+    if (deadline - current_counter < SLEEP_MIN_INTERVAL || !sleep_enabled ||
+        (getDAIF() & 0x2) || getCoreID() != 0) {
+        while (get_timer_counter() < deadline)
+            ;
         return;
     }
-	
-    // Calculate the target value of the system timer counter. This will be the
-    // specified number of microseconds into the future.
-    target_counter = current_counter + interval;
-	    
-    // Keep polling the system timer counter until we reach the target value
-    while (get_timer_counter() < target_counter)
-        ;
-    	
-    // Once we have reached this point, we have delayed the specified number of
-    // microseconds, so return
-    return;
+
+    // Disable IRQs while checking the counter and going to sleep. Otherwise
+    // the interrupt could be taken just before the WFI instruction, which
+    // would then sleep until some unrelated interrupt arrived. WFI still wakes
+    // up when an interrupt is pending, even though it is masked.
+    disableIRQ();
+
+    while (get_timer_counter() < deadline) {
+        // Set the compare register. It only holds the low 32 bits of the
+        // counter, so for deadlines more than about 71 minutes away it will
+        // match early, and we go round the loop again.
+        *SYSTEM_TIMER_C1 = (unsigned int)deadline;
+
+        // If the counter went past the deadline while we were setting the
+        // compare register, the match has been missed, so don't sleep
+        if (get_timer_counter() >= deadline) {
+            break;
+        }
+
+        // Sleep until an interrupt is pending, and then briefly enable IRQs
+        // so that it gets handled
+        waitForInterrupt();
+        enableIRQ();
+        disableIRQ();
+    }
+
+    enableIRQ();
 }
+
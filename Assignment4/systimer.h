@@ -1,3 +1,37 @@
+#ifndef SYSTIMER_H
+#define SYSTIMER_H
+
+// The addresses of the BCM System Timer registers:
+//
+// These are defined on page 175 of the Broadcom BCM2711 ARM Peripherals Manual.
+// Note that we specify the ARM physical addresses of the peripherals, which
+// have the address range 0xFE000000 to 0xFEFFFFFF on the Pi 4.
+//
+// These addresses are mapped by the VideoCore Memory Management Unit (MMU) onto
+// the bus addresses in the range 0x7E000000 to 0x7EFFFFFF.
+
+// This file is included since it defines the memory mapped I/O base address
+#include "gpio.h"
+
+#define SYSTEM_TIMER_CS	    ((volatile unsigned int *)(MMIO_BASE + 0x00003000))
+#define SYSTEM_TIMER_CLO    ((volatile unsigned int *)(MMIO_BASE + 0x00003004))
+#define SYSTEM_TIMER_CHI    ((volatile unsigned int *)(MMIO_BASE + 0x00003008))
+#define SYSTEM_TIMER_C0     ((volatile unsigned int *)(MMIO_BASE + 0x0000300C))
+#define SYSTEM_TIMER_C1     ((volatile unsigned int *)(MMIO_BASE + 0x00003010))
+#define SYSTEM_TIMER_C2     ((volatile unsigned int *)(MMIO_BASE + 0x00003014))
+#define SYSTEM_TIMER_C3     ((volatile unsigned int *)(MMIO_BASE + 0x00003018))
+
+// Bits in the System Timer Control/Status register that are set when the
+// counter matches compare register C1 or C3. Writing a 1 to a bit clears the
+// match. (C0 and C2 are used by the VideoCore firmware.)
+#define SYSTEM_TIMER_CS_M1  (1 << 1)
+#define SYSTEM_TIMER_CS_M3  (1 << 3)
+
+
 // Function prototypes
 unsigned long get_timer_counter();
-void microsecond_delay(unsigned int interval);
+void systimer_init();
+void systimer_irq_handler();
+void sleep_until(unsigned long deadline);
+
+#endif
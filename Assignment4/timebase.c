@@ -0,0 +1,469 @@
+// The functions in this file keep time using the ARM generic timer, which is
+// built into each core. Its counter (CNTPCT_EL0) counts up at a fixed
+// frequency given by CNTFRQ_EL0 (54 MHz on the Pi 4), and is read with a
+// single MRS instruction. This is much cheaper than reading the BCM System
+// Timer, which takes two or three uncached MMIO reads, and unlike the BCM
+// System Timer it is emulated by Qemu, so delays also work under 'make run'.
+//
+// Counter values are converted to nanoseconds and microseconds by multiplying
+// by a precomputed 32.32 fixed-point factor and shifting right by 32, which
+// avoids a division on every call. The 64 x 64-bit multiply keeps the full
+// 128-bit product, so the conversions do not overflow even after the counter
+// has been running for years.
+//
+// The factors are rounded down, so ticks_to_us() and ticks_to_ns() never run
+// ahead of the counter. They fall behind it by less than 1 unit plus 2^-32 of
+// a unit per tick: at 54 MHz, now_us() loses under 13 parts per billion, or
+// about 1.1 ms per day of uptime. Sleeps are timed in counter ticks, with the
+// deadline converted to the first tick at which now_us() reaches it, so the
+// timer compare value and now_us() always agree about when a deadline has
+// passed, however long the core has been running.
+//
+// Times returned by now_us() and now_ns() count from when the core was reset.
+// They are a different timebase from get_timer_counter() in systimer.c.
+
+// Header files
+#include "timebase.h"
+#include "systimer.h"
+#include "sysreg.h"
+#include "gic.h"
+
+// Bits in the CNTP_CTL_EL0 physical timer control register
+#define CNTP_CTL_ENABLE         (1 << 0)
+#define CNTP_CTL_IMASK          (1 << 1)
+
+// The number of fractional bits in the conversion factors
+#define TIMEBASE_SHIFT          32
+
+// Delays shorter than this (in microseconds) are busy-waited, since the time
+// taken to set up the timer interrupt and wake up from it would be a large
+// fraction of the delay
+#define SLEEP_MIN_INTERVAL      10
+
+// The length of the calibration measurement in timebase_calibrate(), in
+// microseconds, and how far the counter frequency reported by CNTFRQ_EL0 may
+// be from the measured frequency before we use the measured one instead
+#define CALIBRATION_INTERVAL    10000
+#define CALIBRATION_TOLERANCE   1000    // Parts per million
+
+// The counter frequency in Hz, and the 32.32 fixed-point factors used to
+// convert between counter ticks and time
+static unsigned long frequency;
+static unsigned long ns_per_tick;
+static unsigned long us_per_tick;
+static unsigned long ticks_per_us;
+
+// Set once the timer interrupt has been enabled by timebase_enable_interrupts().
+// Until then, all delays are busy-waited.
+static int sleep_enabled = 0;
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       multiply_shift
+//
+//  Arguments:      value:   The value to convert
+//                  factor:  A 32.32 fixed-point conversion factor
+//
+//  Returns:        The value multiplied by the factor, rounded down
+//
+//  Description:    This function multiplies two 64-bit values into a 128-bit
+//                  product (a MUL and a UMULH instruction), and drops the 32
+//                  fractional bits.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long multiply_shift(unsigned long value, unsigned long factor)
+{
+    return (unsigned long)(((unsigned __int128)value * factor) >> TIMEBASE_SHIFT);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       set_frequency
+//
+//  Arguments:      hz:      The counter frequency in Hz
+//
+//  Returns:        void
+//
+//  Description:    This function records the counter frequency, and works out
+//                  the conversion factors used by the other functions. They
+//                  are rounded down (see the top of this file).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void set_frequency(unsigned long hz)
+{
+    frequency = hz;
+    ns_per_tick = (1000000000UL << TIMEBASE_SHIFT) / hz;
+    us_per_tick = (1000000UL << TIMEBASE_SHIFT) / hz;
+    ticks_per_us = (hz << TIMEBASE_SHIFT) / 1000000UL;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       timebase_init
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function reads the counter frequency from CNTFRQ_EL0,
+//                  which is set up by the firmware, and works out the
+//                  conversion factors. It must be called before any of the
+//                  other functions in this file.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void timebase_init()
+{
+    unsigned long hz;
+
+
+    // Use the Pi 4's 54 MHz crystal frequency if the firmware did not set
+    // CNTFRQ_EL0
+    hz = getCounterFrequency();
+    if (hz == 0) {
+        hz = 54000000;
+    }
+
+    set_frequency(hz);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       timebase_enable_interrupts
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function enables core 0's physical timer interrupt in
+//                  the GIC, so that sleep_until_us() can put the core to sleep
+//                  instead of polling the counter. gic_init() must be called
+//                  first.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void timebase_enable_interrupts()
+{
+    // Make sure the timer is off until it is needed
+    setPhysicalTimerControl(0);
+
+    irq_register(GIC_CNTP_IRQ_ID, timebase_irq_handler, GIC_DEFAULT_PRIORITY,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+
+    sleep_enabled = 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       timebase_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called from the IRQ handler when the
+//                  physical timer reaches its compare value. The interrupt is
+//                  level-sensitive and stays asserted until the timer is
+//                  reprogrammed, so we mask it. Nothing else needs to be done,
+//                  since it is only used to wake the core from sleep_until_us().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void timebase_irq_handler()
+{
+    setPhysicalTimerControl(CNTP_CTL_ENABLE | CNTP_CTL_IMASK);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       timebase_frequency
+//
+//  Arguments:      none
+//
+//  Returns:        The counter frequency in Hz
+//
+//  Description:    This function returns the counter frequency being used for
+//                  conversions.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned long timebase_frequency()
+{
+    return frequency;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       timebase_calibrate
+//
+//  Arguments:      none
+//
+//  Returns:        The measured counter frequency in Hz, or 0 if it could not
+//                  be measured
+//
+//  Description:    This function measures the counter frequency against the
+//                  BCM System Timer, which always counts at 1 MHz, over a
+//                  10 ms interval. If the frequency given by CNTFRQ_EL0 is
+//                  more than 0.1% away from the measured one (for example
+//                  because the firmware set it up wrongly), the measured one
+//                  is used from then on. Calling this function is optional.
+//                  It returns 0 under Qemu, which does not emulate the BCM
+//                  System Timer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned long timebase_calibrate()
+{
+    unsigned long start_us, end_us, start_ticks, end_ticks, measured, error;
+
+
+    // The System Timer counter is always 0 under Qemu
+    start_us = get_timer_counter();
+    if (start_us == 0) {
+        return 0;
+    }
+
+    // Start and end the measurement just as the System Timer ticks over, so
+    // that the interval is a whole number of microseconds
+    while (get_timer_counter() == start_us)
+        ;
+    start_ticks = timebase_ticks();
+    start_us++;
+
+    while ((end_us = get_timer_counter()) < start_us + CALIBRATION_INTERVAL)
+        ;
+    end_ticks = timebase_ticks();
+
+    // Work out the frequency in Hz
+    measured = (end_ticks - start_ticks) * 1000000UL / (end_us - start_us);
+
+    // Use the measured frequency if CNTFRQ_EL0 is too far out
+    error = measured > frequency ? measured - frequency : frequency - measured;
+    if (error * 1000000UL > frequency * CALIBRATION_TOLERANCE) {
+        set_frequency(measured);
+    }
+
+    return measured;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       ticks_to_ns, ticks_to_us, us_to_ticks
+//
+//  Arguments:      The value to convert
+//
+//  Returns:        The converted value, rounded down
+//
+//  Description:    These functions convert between counter ticks and
+//                  nanoseconds or microseconds.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned long ticks_to_ns(unsigned long ticks)
+{
+    return multiply_shift(ticks, ns_per_tick);
+}
+
+unsigned long ticks_to_us(unsigned long ticks)
+{
+    return multiply_shift(ticks, us_per_tick);
+}
+
+unsigned long us_to_ticks(unsigned long us)
+{
+    return multiply_shift(us, ticks_per_us);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       now_ns, now_us
+//
+//  Arguments:      none
+//
+//  Returns:        The current time in nanoseconds or microseconds
+//
+//  Description:    These functions read the counter and convert its value.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned long now_ns()
+{
+    return ticks_to_ns(timebase_ticks());
+}
+
+unsigned long now_us()
+{
+    return ticks_to_us(timebase_ticks());
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       us_to_deadline_ticks
+//
+//  Arguments:      us:      A time in microseconds, as returned by now_us()
+//
+//  Returns:        The first counter value at which now_us() reaches that time
+//
+//  Description:    This function converts a deadline to counter ticks in a
+//                  way that agrees exactly with ticks_to_us(). We start from
+//                  us_to_ticks() and step forward, each step converting the
+//                  time that is still missing, less 1 microsecond for the
+//                  rounding, plus 1 tick so that every step makes progress.
+//                  Since the factors are rounded, the start or a step can
+//                  land up to about a microsecond of ticks past the answer,
+//                  so we then step back one tick at a time while the tick
+//                  before still reaches the deadline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long us_to_deadline_ticks(unsigned long us)
+{
+    unsigned long ticks, reached;
+
+
+    // Step forward until the deadline is reached
+    ticks = us_to_ticks(us);
+    while ((reached = ticks_to_us(ticks)) < us) {
+        ticks += us_to_ticks(us - reached - 1) + 1;
+    }
+
+    // Step back to the first counter value that reaches it
+    while (ticks > 0 && ticks_to_us(ticks - 1) >= us) {
+        ticks--;
+    }
+
+    return ticks;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       sleep_until_ticks
+//
+//  Arguments:      deadline:     The counter value to wait for
+//
+//  Returns:        void
+//
+//  Description:    This function waits until the counter reaches the given
+//                  value. Instead of polling the counter, it sets the physical
+//                  timer's 64-bit compare register to the deadline and puts
+//                  the core to sleep with the WFI instruction until the timer
+//                  interrupt (or any other interrupt) wakes it up. It returns
+//                  at once if the deadline has already passed.
+//
+//                  The counter is polled instead for delays shorter than
+//                  SLEEP_MIN_INTERVAL, before timebase_enable_interrupts() is
+//                  called, when IRQs are disabled, and on cores other than
+//                  core 0 (the timer interrupt is only enabled for core 0).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void sleep_until_ticks(unsigned long deadline)
+{
+    unsigned long current_ticks;
+
+
+    current_ticks = timebase_ticks();
+    if (current_ticks >= deadline) {
+        return;
+    }
+
+    // Poll the counter if the delay is short, or if we can't use the interrupt
+    if (ticks_to_us(deadline - current_ticks) < SLEEP_MIN_INTERVAL ||
+        !sleep_enabled || (getDAIF() & 0x2) || getCoreID() != 0) {
+        while (timebase_ticks() < deadline)
+            ;
+        return;
+    }
+
+    // Disable IRQs while checking the time and going to sleep. Otherwise the
+    // interrupt could be taken just before the WFI instruction, which would
+    // then sleep until some unrelated interrupt arrived. WFI still wakes up
+    // when an interrupt is pending, even though it is masked.
+    disableIRQ();
+
+    while (timebase_ticks() < deadline) {
+        // Set the compare value and unmask the timer interrupt. The timer
+        // fires once the counter reaches the compare value, which is exactly
+        // when this loop ends, so it is raised only once. If the deadline has
+        // already been reached, the interrupt is raised at once, so unlike a
+        // 32-bit compare register it cannot be missed.
+        setPhysicalTimerCompare(deadline);
+        setPhysicalTimerControl(CNTP_CTL_ENABLE);
+
+        // Sleep until an interrupt is pending, and then briefly enable IRQs
+        // so that it gets handled
+        waitForInterrupt();
+        enableIRQ();
+        disableIRQ();
+    }
+
+    // Turn the timer off again
+    setPhysicalTimerControl(0);
+
+    enableIRQ();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       sleep_until_us
+//
+//  Arguments:      deadline:     The time to wait for, as returned by now_us()
+//
+//  Returns:        void
+//
+//  Description:    This function waits until now_us() reaches the given time,
+//                  by converting it to the counter value at which that happens
+//                  and calling sleep_until_ticks().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void sleep_until_us(unsigned long deadline)
+{
+    sleep_until_ticks(us_to_deadline_ticks(deadline));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       microsecond_delay
+//
+//  Arguments:      interval:     The time to delay in microseconds
+//
+//  Returns:        void
+//
+//  Description:    This function delays the specified number of microseconds,
+//                  by calling sleep_until_us().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void microsecond_delay(unsigned int interval)
+{
+    sleep_until_us(now_us() + interval);
+}
@@ -0,0 +1,45 @@
+// These are the function prototypes for the timebase, which keeps time using
+// the ARM generic timer (see timebase.c)
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+// Read the ARM generic timer's physical counter (CNTPCT_EL0). This is inline so
+// that reading the time costs a single MRS instruction, with no MMIO access.
+// The ISB stops the processor from reading the counter early, out of program
+// order. In the host build, the simulator provides the counter (see sim/).
+#ifdef HOST
+unsigned long sim_counter();
+
+static inline unsigned long timebase_ticks()
+{
+    return sim_counter();
+}
+#else
+static inline unsigned long timebase_ticks()
+{
+    unsigned long ticks;
+
+    asm volatile("isb\n\tmrs %0, cntpct_el0" : "=r" (ticks) : : "memory");
+
+    return ticks;
+}
+#endif
+
+void timebase_init();
+void timebase_enable_interrupts();
+void timebase_irq_handler();
+unsigned long timebase_frequency();
+unsigned long timebase_calibrate();
+
+unsigned long ticks_to_ns(unsigned long ticks);
+unsigned long ticks_to_us(unsigned long ticks);
+unsigned long us_to_ticks(unsigned long us);
+unsigned long now_ns();
+unsigned long now_us();
+
+void sleep_until_ticks(unsigned long deadline);
+void sleep_until_us(unsigned long deadline);
+void microsecond_delay(unsigned int interval);
+
+#endif
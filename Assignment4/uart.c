@@ -2,11 +2,24 @@
 // allows communication between a host and the Raspberry Pi using a UART serial
 // connection. Once uart_init() has been called, the Pi can transmit and receive
 // characters over the UART connection using the functions uart_putc(),
-// uart_puts(), uart_getc(), uart_puthex().
+// uart_puts(), uart_write(), uart_getc(), uart_puthex().
+//
+// By default, these functions poll the UART until it is ready to send or has
+// received a character. Once uart_enable_interrupts() has been called, the UART
+// is instead driven by interrupts: characters to be sent are put into a
+// transmit ring buffer and the functions return right away, and the interrupt
+// handler moves characters between the ring buffers and the UART's FIFOs. If a
+// ring buffer fills up, further characters are dropped and counted.
 
 // This file is included since it defines the memory mapped I/O base address
 #include "gpio.h"
 
+// Header files
+#include "gic.h"
+#include "ringbuf.h"
+#include "shadow.h"
+#include "uart.h"
+
 // The addresses of the Auxilary Mini UART registers:
 //
 // These are defined on pages 12 - 13 of the Broadcom BCM2711 ARM Peripherals
@@ -28,6 +41,37 @@
 #define AUX_MU_STAT     ((volatile unsigned int *)(MMIO_BASE + 0x00215064))
 #define AUX_MU_BAUD     ((volatile unsigned int *)(MMIO_BASE + 0x00215068))
 
+// Fields in the Mini UART Interrupt Enable Register. Note that the manual has
+// the receive and transmit bits the wrong way round, and that bits 3:2 must
+// also be set for receive interrupts to be generated.
+#define AUX_MU_IER_RX   0xD
+#define AUX_MU_IER_TX   0x2
+
+// The depth of the Mini UART transmit FIFO
+#define AUX_MU_FIFO_SIZE        8
+
+// In benchmark builds, we count every read of a UART status register, so that
+// bench.c can report how many uncached MMIO reads are needed per byte sent
+#ifdef BENCHMARK
+static unsigned int mmio_reads;
+#define COUNT_MMIO_READ()       (mmio_reads++)
+#else
+#define COUNT_MMIO_READ()
+#endif
+
+// Sizes of the ring buffers used in interrupt-driven mode. These must be
+// powers of two.
+#define UART_TX_BUFFER_SIZE     1024
+#define UART_RX_BUFFER_SIZE     256
+
+// Ring buffers and state used in interrupt-driven mode
+static unsigned char tx_data[UART_TX_BUFFER_SIZE];
+static unsigned char rx_data[UART_RX_BUFFER_SIZE];
+static struct ringbuf tx_buffer, rx_buffer;
+static volatile int uart_async;
+static volatile int tx_interrupt_enabled;
+static volatile unsigned int tx_overflows, rx_overflows;
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -48,43 +92,17 @@
 
 void uart_init()
 {
-    register unsigned int r;
+    static const struct gpio_pin_config pins[] = {
+        { 14, GPIO_FUNCTION_ALT5, GPIO_PULL_NONE },
+        { 15, GPIO_FUNCTION_ALT5, GPIO_PULL_NONE }
+    };
     
 
-    // Map the Mini UART (UART1) to GPIO pins 14 and 15. The GPIO pins must be
-    // set up before initializing the Mini UART.
-
-    // Get the current contents of the GPIO Function Select Register 1
-    r = *GPFSEL1;
-
-    // Clear bits 12-14 and 15-17. These are the fields FSEL14 and FSEL15, which
-    // map to GPIO pins 14 and 15. We clear the bits by ANDing with a 000 bit
-    // pattern in the two fields.
-    r &= ~( (0x7 << 12) | (0x7 << 15) );
-
-    // Set the fields FSEL14 and FSEL15 to alternate function 5, which maps the
-    // Mini UART peripheral to GPIO pins 14 and 15. We do so by ORing the bit
-    // pattern 010 into the fields. This function treats pin 14 as a UART TXD
-    // pin, and pin 15 as a UART RXD pin.
-    r |= (0x2 << 12) | (0x2 << 15);
-
-    // Write the modified bit pattern back to the GPIO Function Select
-    // Register 1
-    *GPFSEL1 = r;
-
-
-
-    // Disable the pull-up/pull-down control lines for GPIO pins 14 and 15
-
-    // Get the current bit pattern of the GPPUPPDN0 register
-    r = *GPPUPPDN0;
-
-    // Zero out bits 28-29 and 30-31 in this bit pattern, since these map to
-    // GPIO pins 14 and 15. The bit pattern 00 disables pullups/pulldowns.
-    r &= ~( (0x3 << 28) | (0x3 << 30) );
-
-    // Write the modified bit pattern back to the GPPUPPDN0 register
-    *GPPUPPDN0 = r;
+    // Map the Mini UART (UART1) to GPIO pins 14 and 15, by setting them to
+    // alternate function 5, and disable their pull-up/pull-down control lines.
+    // The GPIO pins must be set up before initializing the UART. Pin 14 is
+    // treated as a UART TXD pin, and pin 15 as a UART RXD pin.
+    gpio_configure(pins, 2);
 
     
     
@@ -92,7 +110,7 @@ void uart_init()
     
     // Enable the Mini UART by setting bit 0 in the Auxiliary Enable register
     // to a 1 value
-    *AUX_ENABLE |= 0x1;
+    shadow_modify(SHADOW_AUX_ENABLE, 0, 0x1);
     
     // Disable all Mini UART interrupts by setting all fields in the Mini UART
     // Interrupt Enable Register to zero
@@ -128,6 +146,57 @@ void uart_init()
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_queue
+//
+//  Arguments:      c:     The character to queue
+//
+//  Returns:        void
+//
+//  Description:    This function puts a character into the transmit ring
+//                  buffer (interrupt-driven mode only). If the buffer is full,
+//                  the character is dropped and counted.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void uart_queue(unsigned int c)
+{
+    if (!ringbuf_put(&tx_buffer, c)) {
+        tx_overflows++;
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_start_tx
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function makes sure that the transmit interrupt is
+//                  enabled, so that the interrupt handler will send whatever
+//                  is in the transmit ring buffer (interrupt-driven mode
+//                  only). Characters must be queued before calling this, in
+//                  case the handler runs in between and turns the interrupt
+//                  off. The enable register is only written if the interrupt
+//                  is currently off.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void uart_start_tx()
+{
+    if (!tx_interrupt_enabled) {
+        tx_interrupt_enabled = 1;
+        *AUX_MU_IER = AUX_MU_IER_RX | AUX_MU_IER_TX;
+    }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //  Function:       uart_putc
@@ -139,18 +208,28 @@ void uart_init()
 //  Description:    This function polls the UART1 peripheral, waiting until it
 //                  is able to accept a new character into its buffer. The
 //                  character c is then sent to the console terminal over the
-//                  TXD line.
+//                  TXD line. In interrupt-driven mode, the character is put
+//                  into the transmit ring buffer instead.
 //
 ////////////////////////////////////////////////////////////////////////////////
 
 void uart_putc(unsigned int c)
 {
+    // In interrupt-driven mode, queue the character and let the interrupt
+    // handler send it
+    if (uart_async) {
+        uart_queue(c);
+        uart_start_tx();
+        return;
+    }
+
     // Loop until the transmit FIFO buffer is able to accept a character for
     // transmission. This will be true when the Transmitter Empty bit (bit 5)
     // in the Mini UART Line Status Register is a 1 value.
     do {
     	// Use the NOP assembly language instruction in the loop body
       	asm volatile("nop");
+        COUNT_MMIO_READ();
     } while ( !(*AUX_MU_LSR & 0x20) );
     
     // Write the character to the mini UART I/O register
@@ -158,6 +237,33 @@ void uart_putc(unsigned int c)
 }
 
 
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_rx_ready
+//
+//  Arguments:      none
+//
+//  Returns:        1 if a received character is waiting, or 0 otherwise
+//
+//  Description:    This function checks, without waiting, whether uart_getc()
+//                  would return a character straight away.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int uart_rx_ready()
+{
+    // In interrupt-driven mode, check the receive ring buffer
+    if (uart_async) {
+        return !ringbuf_empty(&rx_buffer);
+    }
+
+    // Otherwise check the Data Ready bit (bit 0) in the Mini UART Line Status
+    // Register
+    return *AUX_MU_LSR & 0x1;
+}
+
+
  
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -170,14 +276,26 @@ void uart_putc(unsigned int c)
 //  Description:    This function polls the UART1 peripheral, waiting for a
 //                  single character to be received from the console terminal
 //                  over the RXD line. If the character is a carriage return,
-//                  it is converted to a newline character.
+//                  it is converted to a newline character. In interrupt-driven
+//                  mode, the character is taken from the receive ring buffer.
 //
 ////////////////////////////////////////////////////////////////////////////////
 
 char uart_getc()
 {
     char r;
+    unsigned char c;
     
+    // In interrupt-driven mode, wait until the interrupt handler has put a
+    // character into the receive ring buffer
+    if (uart_async) {
+        while (!ringbuf_get(&rx_buffer, &c)) {
+            asm volatile("nop");
+        }
+        
+        return c == '\r' ? '\n' : c;
+    }
+
     // Loop until an input character is available in the receive FIFO buffer.
     // At least one character is available when the Data Ready bit (bit 0) in
     // the Mini UART Line Status Register is a 1 value.
@@ -196,6 +314,116 @@ char uart_getc()
 
 
  
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_send
+//
+//  Arguments:      p:     A pointer to the characters to write
+//                  n:     The number of characters to write
+//                  crlf:  If non-zero, newlines are sent as CR/LF pairs
+//
+//  Returns:        void
+//
+//  Description:    This function writes n characters to the console terminal
+//                  using the TXD function of the UART1 peripheral. If crlf is
+//                  non-zero, each newline character is sent as a carriage
+//                  return followed by a newline. Rather than polling the Line
+//                  Status Register before every character, we read the transmit
+//                  FIFO fill level once, and then write as many characters as
+//                  will fit in the FIFO one after the other. In
+//                  interrupt-driven mode, the characters are all queued before
+//                  the transmit interrupt is enabled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void uart_send(const unsigned char *p, size_t n, int crlf)
+{
+    unsigned int room;
+    int cr_sent = 0;
+
+
+    // In interrupt-driven mode, queue all the characters and let the
+    // interrupt handler send them
+    if (uart_async) {
+        while (n--) {
+            if (crlf && *p == '\n')
+                uart_queue('\r');
+            uart_queue(*p++);
+        }
+        uart_start_tx();
+        return;
+    }
+
+    // Keep going until all the characters have been written
+    while (n) {
+        // Find out how much room there is in the transmit FIFO. Bits 27:24 in
+        // the Mini UART Extra Status Register give the number of characters
+        // that are in the FIFO.
+        COUNT_MMIO_READ();
+        room = AUX_MU_FIFO_SIZE - ((*AUX_MU_STAT >> 24) & 0xF);
+
+        // Write characters until the FIFO is full or we run out. A newline
+        // takes two slots, so we note when its carriage return has gone out
+        // in case the newline itself has to wait for the next burst.
+        while (room && n) {
+            if (crlf && *p == '\n' && !cr_sent) {
+                *AUX_MU_IO = '\r';
+                cr_sent = 1;
+            } else {
+                *AUX_MU_IO = *p++;
+                cr_sent = 0;
+                n--;
+            }
+            room--;
+        }
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_write
+//
+//  Arguments:      buf:   A pointer to the characters to write
+//                  n:     The number of characters to write
+//
+//  Returns:        void
+//
+//  Description:    This function writes n characters of text to the console
+//                  terminal. Each newline character is sent as a carriage
+//                  return followed by a newline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_write(const void *buf, size_t n)
+{
+    uart_send(buf, n, 1);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_write_binary
+//
+//  Arguments:      buf:   A pointer to the bytes to write
+//                  n:     The number of bytes to write
+//
+//  Returns:        void
+//
+//  Description:    This function writes n bytes of binary data over the UART
+//                  exactly as they are, without any newline translation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_write_binary(const void *buf, size_t n)
+{
+    uart_send(buf, n, 0);
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //  Function:       uart_puts
@@ -211,17 +439,15 @@ char uart_getc()
 
 void uart_puts(char *s)
 {
-    // Keep processing characters in the string until we reach a null
-    // terminating character
-    while (*s) {
-        // If we encounter a newline character in the string then also send a
-        // carriage return just before the newline
-        if (*s == '\n')
-            uart_putc('\r');
-
-	    // Send the current character, and increment the pointer
-        uart_putc(*s++);
-    }
+    size_t n = 0;
+
+    // Find the length of the string, up to the null terminating character
+    while (s[n])
+        n++;
+
+    // Write the whole string in bursts. This also sends a carriage return just
+    // before each newline.
+    uart_write(s, n);
 }
 
 
@@ -245,6 +471,7 @@ void uart_puthex(unsigned int value)
 {
     register unsigned int digit;
     register int i;
+    char digits[8];
 
     // Loop 8 times, isolating each 4-bit unit in turn, starting with the
     // leftmost unit
@@ -262,7 +489,211 @@ void uart_puthex(unsigned int value)
             digit += 0x30;
         }
 
-        // Write the digit to the console terminal
-        uart_putc(digit);
+        // Store the digit
+        digits[7 - i / 4] = digit;
+    }
+
+    // Write all 8 digits to the console terminal in one burst
+    uart_write(digits, 8);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_flush
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function waits until every character written so far
+//                  has been sent out over the TXD line. This is true when the
+//                  Transmitter Idle bit (bit 6) in the Mini UART Line Status
+//                  Register is a 1 value, which means that the transmit FIFO
+//                  buffer is empty and the transmitter is idle. In interrupt-
+//                  driven mode, we first wait for the transmit ring buffer to
+//                  empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_flush()
+{
+    // Wait for the interrupt handler to move everything out of the transmit
+    // ring buffer and into the FIFO
+    while (uart_async && !ringbuf_empty(&tx_buffer)) {
+        asm volatile("nop");
+    }
+
+    // Loop until the transmit FIFO buffer and the transmitter are both empty
+    do {
+    	// Use the NOP assembly language instruction in the loop body
+        asm volatile("nop");
+        COUNT_MMIO_READ();
+    } while ( !(*AUX_MU_LSR & 0x40) );
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_enable_interrupts
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function switches the UART into interrupt-driven mode.
+//                  The receive interrupt is enabled in the Mini UART and the
+//                  AUX interrupt (ID 125) is enabled in the GIC. The GIC must
+//                  already have been set up using gic_init(), and IRQ
+//                  exceptions must be enabled on the core for the UART to
+//                  work in this mode.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_enable_interrupts()
+{
+    // Wait for any characters written in polled mode to go out
+    uart_flush();
+
+    // Start with empty ring buffers
+    ringbuf_init(&tx_buffer, tx_data, UART_TX_BUFFER_SIZE);
+    ringbuf_init(&rx_buffer, rx_data, UART_RX_BUFFER_SIZE);
+    tx_overflows = rx_overflows = 0;
+    uart_async = 1;
+
+    // Enable the receive interrupt only. The transmit interrupt is enabled
+    // whenever there are characters to send.
+    tx_interrupt_enabled = 0;
+    *AUX_MU_IER = AUX_MU_IER_RX;
+
+    // Register the AUX interrupt handler, and enable it in the GIC
+    irq_register(GIC_AUX_IRQ_ID, uart_irq_handler, GIC_PRIORITY_LOW,
+                 GIC_TARGET_CORE0, GIC_GICD_ICFGR_LEVEL);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_tx_empty
+//
+//  Arguments:      none
+//
+//  Returns:        1 if the transmit ring buffer is empty, 0 if it is not
+//
+//  Description:    This function tells whether every character written so far
+//                  has been moved into the transmit FIFO. It is always true
+//                  when the UART is not interrupt-driven.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int uart_tx_empty()
+{
+    return ringbuf_empty(&tx_buffer);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_tx_drained
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called in interrupt-driven mode whenever
+//                  the last character in the transmit ring buffer has been
+//                  written into the transmit FIFO. This default version does
+//                  nothing. It is declared weak so that the program can define
+//                  its own version, e.g. to time how long output takes (see
+//                  latency.c).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((weak)) void uart_tx_drained()
+{
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_irq_handler
+//
+//  Arguments:      none
+//
+//  Returns:        void
+//
+//  Description:    This function is called by the IRQ handler when the AUX
+//                  interrupt is pending. It moves all received characters
+//                  from the receive FIFO into the receive ring buffer, and
+//                  fills the transmit FIFO from the transmit ring buffer. Once
+//                  the transmit ring buffer is empty, the transmit interrupt
+//                  is disabled so that it does not keep firing.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_irq_handler()
+{
+    unsigned char c;
+    int sent;
+
+
+    // Empty the receive FIFO. The Data Ready bit (bit 0) in the Mini UART
+    // Line Status Register is 1 while there are characters in the FIFO.
+    while (*AUX_MU_LSR & 0x1) {
+        c = (unsigned char)(*AUX_MU_IO);
+        if (!ringbuf_put(&rx_buffer, c)) {
+            rx_overflows++;
+        }
+    }
+
+    // Fill the transmit FIFO while it has room (bit 5) and we have characters
+    // to send
+    sent = 0;
+    while ((*AUX_MU_LSR & 0x20) && ringbuf_get(&tx_buffer, &c)) {
+        *AUX_MU_IO = c;
+        sent = 1;
+    }
+
+    // Turn off the transmit interrupt when there is nothing left to send
+    if (ringbuf_empty(&tx_buffer)) {
+        tx_interrupt_enabled = 0;
+        *AUX_MU_IER = AUX_MU_IER_RX;
+        if (sent) {
+            uart_tx_drained();
+        }
     }
 }
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Function:       uart_get_stats
+//
+//  Arguments:      stats:    A pointer to the structure to fill in
+//
+//  Returns:        void
+//
+//  Description:    This function reports the number of characters that were
+//                  dropped in interrupt-driven mode because the transmit or
+//                  receive ring buffer was full. In benchmark builds, it also
+//                  reports the number of status register reads made while
+//                  transmitting in polled mode.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void uart_get_stats(struct uart_stats *stats)
+{
+    stats->tx_overflows = tx_overflows;
+    stats->rx_overflows = rx_overflows;
+#ifdef BENCHMARK
+    stats->mmio_reads = mmio_reads;
+#else
+    stats->mmio_reads = 0;
+#endif
+}
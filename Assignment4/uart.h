@@ -1,7 +1,42 @@
-// These are the function prototypes for reading/writing the Mini UART
+// These are the function prototypes for reading/writing the UART. They are
+// implemented for the Mini UART in uart.c, and for the PL011 UART in pl011.c
+// (which is used when UART_PL011 is defined).
+
+#ifndef UART_H
+#define UART_H
+
+// The GIC interrupt ID of the UART that is in use (see gic.h)
+#ifdef UART_PL011
+#define UART_IRQ_ID     GIC_PL011_IRQ_ID
+#else
+#define UART_IRQ_ID     GIC_AUX_IRQ_ID
+#endif
+
+// The type used for sizes (there is no standard library)
+typedef unsigned long size_t;
+
+// Counts of characters dropped in interrupt-driven mode, and of UART status
+// register reads while transmitting (benchmark builds only)
+struct uart_stats {
+    unsigned int tx_overflows;      // Transmit ring buffer was full
+    unsigned int rx_overflows;      // Receive ring buffer was full
+    unsigned int mmio_reads;        // Status register reads
+};
 
 void uart_init();
 void uart_putc(unsigned int c);
 char uart_getc();
+int uart_rx_ready();
 void uart_puts(char *s);
+void uart_write(const void *buf, size_t n);
+void uart_write_binary(const void *buf, size_t n);
 void uart_puthex(unsigned int value);
+void uart_flush();
+
+void uart_enable_interrupts();
+void uart_irq_handler();
+int uart_tx_empty();
+void uart_tx_drained();
+void uart_get_stats(struct uart_stats *stats);
+
+#endif